@@ -0,0 +1,433 @@
+// Times every stage of the step pipeline over a sweep of blob counts, species
+// counts, densities, thread counts and interaction modes, and writes the
+// results as JSON (median and percentiles per stage, in milliseconds).
+// Builds without SFML, like the headless runner.
+//
+// usage: benchmark [--blobs 1000,10000,...] [--species 4,16] [--density 25,50,100]
+//                  [--threads 1,8] [--modes vectorized,symmetric,per-blob,lists]
+//                  [--steps 50] [--warmup 5] [--max-seconds 5] [--out results.json]
+//                  [--layout uniform|clusters|rings|regions] [--view 1]
+//
+// Density is blobs per 100 x 100 pixels (the windowed default is 50); the world
+// is sized to match. Sampling a configuration stops after --steps steps or
+// --max-seconds, whichever comes first.
+//
+// Every step is followed by what the front-end does with it: a snapshot, then
+// the vertex fill of the blobs in view, culled by grid cell. The view is a
+// square in the middle of the world, --view of its side (1 is the whole world,
+// like the window's initial camera).
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim/world.hpp"
+
+// same layout as sf::Vertex, so the vertex fill moves the same bytes as the front-end's
+struct Vertex {
+    float x, y;
+    uint8_t r, g, b, a;
+    float u, v;
+};
+
+struct BenchConfig {
+    int num_blobs;
+    int num_species;
+    float density;
+    int num_threads;
+    InteractionMode mode;
+    BlobLayout layout;
+};
+
+const char* mode_name(InteractionMode mode) {
+    switch (mode) {
+        case InteractionMode::PerBlob: return "per-blob";
+        case InteractionMode::Symmetric: return "symmetric";
+        case InteractionMode::Vectorized: return "vectorized";
+        case InteractionMode::NeighborLists: return "lists";
+    }
+    return "unknown";
+}
+
+bool parse_mode(const std::string& name, InteractionMode& mode) {
+    const InteractionMode modes[] = {InteractionMode::PerBlob, InteractionMode::Symmetric, InteractionMode::Vectorized, InteractionMode::NeighborLists};
+    for (InteractionMode m : modes) {
+        if (name == mode_name(m)) {
+            mode = m;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_layout(const std::string& name, BlobLayout& layout) {
+    const BlobLayout layouts[] = {BlobLayout::Uniform, BlobLayout::Clusters, BlobLayout::Rings, BlobLayout::SpeciesRegions};
+    for (BlobLayout l : layouts) {
+        if (name == blob_layout_name(l)) {
+            layout = l;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::vector<double> parse_numbers(const std::string& list) {
+    std::vector<double> numbers;
+    for (const std::string& item : split(list)) {
+        numbers.push_back(std::atof(item.c_str()));
+    }
+    return numbers;
+}
+
+// nearest-rank percentile of sorted samples
+double percentile(const std::vector<double>& sorted, double p) {
+    int rank = static_cast<int>(std::ceil(p / 100.0 * sorted.size()));
+    return sorted[std::min(std::max(rank, 1), static_cast<int>(sorted.size())) - 1];
+}
+
+void write_stats(std::ostream& out, const char* name, std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (double sample : samples) {
+        sum += sample;
+    }
+    out << "        \"" << name << "\": {"
+        << "\"median_ms\": " << percentile(samples, 50) * 1e3
+        << ", \"mean_ms\": " << sum / samples.size() * 1e3
+        << ", \"min_ms\": " << samples.front() * 1e3
+        << ", \"p10_ms\": " << percentile(samples, 10) * 1e3
+        << ", \"p90_ms\": " << percentile(samples, 90) * 1e3
+        << ", \"p99_ms\": " << percentile(samples, 99) * 1e3
+        << ", \"max_ms\": " << samples.back() * 1e3 << "}";
+}
+
+// texcoords are written once, like the front-end's vertex buffer
+void init_vertices(std::vector<Vertex>& vertices, std::vector<uint8_t>& drawn_species, int num_blobs) {
+    const float texture_size = 1024.0f;
+    vertices.assign(num_blobs * 4, Vertex());
+    for (int i = 0; i < num_blobs; ++i) {
+        Vertex* quad = &vertices[i * 4];
+        quad[1].u = texture_size;
+        quad[2].u = texture_size;
+        quad[2].v = texture_size;
+        quad[3].v = texture_size;
+    }
+    drawn_species.assign(num_blobs, 255);
+}
+
+// positions of blobs [start, end) of the snapshot, from quad first_quad on, and colors
+// only where the species of the quad changed
+void fill_vertices(const WorldSnapshot& blobs, float radius, std::vector<Vertex>& vertices, std::vector<uint8_t>& drawn_species,
+                   int start, int end, int first_quad) {
+    for (int i = start; i < end; ++i) {
+        int q = first_quad + i - start;
+        Vertex* quad = &vertices[q * 4];
+        float x = blobs.x[i];
+        float y = blobs.y[i];
+        quad[0].x = x - radius;
+        quad[0].y = y - radius;
+        quad[1].x = x + radius;
+        quad[1].y = y - radius;
+        quad[2].x = x + radius;
+        quad[2].y = y + radius;
+        quad[3].x = x - radius;
+        quad[3].y = y + radius;
+        if (drawn_species[q] != blobs.species[i]) {
+            uint8_t shade = static_cast<uint8_t>(blobs.species[i] * 8);
+            for (int k = 0; k < 4; ++k) {
+                quad[k].r = shade;
+                quad[k].g = shade;
+                quad[k].b = shade;
+                quad[k].a = 255;
+            }
+            drawn_species[q] = blobs.species[i];
+        }
+    }
+}
+
+// quads [first_quad, last_quad) of the blobs in the window, packed row after row like the front-end's
+void fill_visible_vertices(const WorldSnapshot& blobs, float radius, const CellWindow& cells, const std::vector<int>& row_quads,
+                           std::vector<Vertex>& vertices, std::vector<uint8_t>& drawn_species, int first_quad, int last_quad) {
+    int n = std::upper_bound(row_quads.begin(), row_quads.end(), first_quad) - row_quads.begin() - 1;
+    for (int quad = first_quad; quad < last_quad; ++n) {
+        int row_last_quad = std::min(row_quads[n + 1], last_quad);
+        int start = row_begin(blobs, cells, n) + quad - row_quads[n];
+        fill_vertices(blobs, radius, vertices, drawn_species, start, start + row_last_quad - quad, quad);
+        quad = row_last_quad;
+    }
+}
+
+// run one configuration and append its JSON object to out
+void run_config(const BenchConfig& config, int max_steps, int warmup_steps, double max_seconds, float view_fraction, std::ostream& out) {
+    WorldParams params;
+    params.num_blobs = config.num_blobs;
+    params.num_species = config.num_species;
+    params.num_threads = config.num_threads;
+    params.interaction_mode = config.mode;
+    params.layout = config.layout;
+    float side = std::sqrt(config.num_blobs / config.density) * 100.0f;
+    params.world_width = side;
+    params.world_height = side;
+
+    // every configuration starts from the default seed
+    std::chrono::steady_clock::time_point init_start = std::chrono::steady_clock::now();
+    World world(params);
+    double init_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - init_start).count();
+    // the mouse sits in the middle of the world, so the mouse pass does real work
+    world.set_mouse(side / 2, side / 2, true);
+
+    // the front-end fills on its own pool while the world steps; here the world's
+    // pool fills between steps, so the fill gets as many threads as the step
+    ThreadPool& pool = world.pool();
+    WorldSnapshot snapshot;
+    std::vector<Vertex> vertices;
+    std::vector<uint8_t> drawn_species;
+    init_vertices(vertices, drawn_species, config.num_blobs);
+    std::vector<int> row_quads;
+    const float radius = params.blob_size;
+    float view_side = side * view_fraction;
+    float view_left = (side - view_side) / 2 - radius;  // widened by a blob, like the front-end's culling
+    float view_width = view_side + 2 * radius;
+    CellWindow cells;
+    int num_quads = 0;
+    std::vector<Phase> fill_phases = {
+        [&](int t) {
+            fill_visible_vertices(snapshot, radius, cells, row_quads, vertices, drawn_species,
+                                  pool.range_begin(t, num_quads), pool.range_end(t, num_quads));
+        },
+    };
+
+    world.step(warmup_steps);
+
+    std::vector<std::vector<double> > stage_samples(NUM_STEP_STAGES);
+    std::vector<double> step_samples;
+    std::vector<double> snapshot_samples;
+    std::vector<double> fill_samples;
+    std::vector<double> frame_samples;
+    long long visible_blobs = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int s = 0; s < max_steps; ++s) {
+        world.step();
+        std::chrono::steady_clock::time_point snapshot_start = std::chrono::steady_clock::now();
+        world.snapshot(snapshot);
+        std::chrono::steady_clock::time_point fill_start = std::chrono::steady_clock::now();
+        cells = cells_in_rect(snapshot, view_left, view_left, view_width, view_width);
+        row_quads.assign(1, 0);
+        for (int n = 0; n < cells.num_rows(); ++n) {
+            row_quads.push_back(row_quads.back() + row_end(snapshot, cells, n) - row_begin(snapshot, cells, n));
+        }
+        num_quads = row_quads.back();
+        pool.run(fill_phases);
+        std::chrono::steady_clock::time_point fill_end = std::chrono::steady_clock::now();
+        double snapshot_seconds = std::chrono::duration<double>(fill_start - snapshot_start).count();
+        double fill_seconds = std::chrono::duration<double>(fill_end - fill_start).count();
+        visible_blobs += num_quads;
+
+        const StepTiming& timing = world.last_step_timing();
+        for (int stage = 0; stage < NUM_STEP_STAGES; ++stage) {
+            stage_samples[stage].push_back(timing.stage_seconds[stage]);
+        }
+        step_samples.push_back(timing.total_seconds);
+        snapshot_samples.push_back(snapshot_seconds);
+        fill_samples.push_back(fill_seconds);
+        frame_samples.push_back(timing.total_seconds + snapshot_seconds + fill_seconds);
+
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (s + 1 >= 5 && elapsed > max_seconds) {
+            break;
+        }
+    }
+
+    std::vector<double> sorted_frames = frame_samples;
+    std::sort(sorted_frames.begin(), sorted_frames.end());
+    out << "    {\n"
+        << "      \"blobs\": " << config.num_blobs
+        << ", \"species\": " << config.num_species
+        << ", \"density\": " << config.density
+        << ", \"world_size\": " << side
+        << ", \"threads\": " << config.num_threads
+        << ", \"mode\": \"" << mode_name(config.mode) << "\""
+        << ", \"layout\": \"" << blob_layout_name(config.layout) << "\""
+        << ", \"init_ms\": " << init_seconds * 1e3
+        << ", \"view\": " << view_fraction
+        << ", \"visible_blobs\": " << visible_blobs / static_cast<long long>(step_samples.size())
+        << ", \"steps\": " << step_samples.size()
+        << ", \"steps_per_sec\": " << 1.0 / percentile(sorted_frames, 50) << ",\n"
+        << "      \"stages\": {\n";
+    for (int stage = 0; stage < NUM_STEP_STAGES; ++stage) {
+        write_stats(out, step_stage_name(static_cast<StepStage>(stage)), stage_samples[stage]);
+        out << ",\n";
+    }
+    write_stats(out, "snapshot", snapshot_samples);
+    out << ",\n";
+    write_stats(out, "vertex_fill", fill_samples);
+    out << ",\n";
+    write_stats(out, "step", step_samples);
+    out << ",\n";
+    write_stats(out, "frame", frame_samples);
+    out << "\n      }\n    }";
+
+    std::cerr << mode_name(config.mode) << " blobs=" << config.num_blobs << " species=" << config.num_species
+              << " density=" << config.density << " threads=" << config.num_threads
+              << ": " << percentile(sorted_frames, 50) * 1e3 << " ms/frame median" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    int hardware_threads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<double> blob_counts = {1000, 10000, 100000, 1000000};
+    std::vector<double> species_counts = {4, 16};
+    std::vector<double> densities = {25, 50, 100};
+    std::vector<double> thread_counts = {1};
+    if (hardware_threads > 1) {
+        thread_counts.push_back(hardware_threads);
+    }
+    std::vector<InteractionMode> modes = {InteractionMode::Vectorized};
+    BlobLayout layout = BlobLayout::Uniform;
+    int max_steps = 50;
+    int warmup_steps = 5;
+    double max_seconds = 5.0;
+    float view_fraction = 1.0f;
+    std::string out_path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << arg << std::endl;
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--blobs") {
+            blob_counts = parse_numbers(value);
+        }
+        else if (arg == "--species") {
+            species_counts = parse_numbers(value);
+        }
+        else if (arg == "--density") {
+            densities = parse_numbers(value);
+        }
+        else if (arg == "--threads") {
+            thread_counts = parse_numbers(value);
+        }
+        else if (arg == "--modes") {
+            modes.clear();
+            for (const std::string& name : split(value)) {
+                InteractionMode mode;
+                if (!parse_mode(name, mode)) {
+                    std::cerr << "unknown mode " << name << std::endl;
+                    return 1;
+                }
+                modes.push_back(mode);
+            }
+        }
+        else if (arg == "--layout") {
+            if (!parse_layout(value, layout)) {
+                std::cerr << "unknown layout " << value << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--steps") {
+            max_steps = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (arg == "--warmup") {
+            warmup_steps = std::max(0, std::atoi(value.c_str()));
+        }
+        else if (arg == "--max-seconds") {
+            max_seconds = std::atof(value.c_str());
+        }
+        else if (arg == "--view") {
+            view_fraction = std::atof(value.c_str());
+            if (view_fraction <= 0.0f || view_fraction > 1.0f) {
+                std::cerr << "view must be in (0, 1]" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--out") {
+            out_path = value;
+        }
+        else {
+            std::cerr << "unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    for (double species : species_counts) {
+        if (species < 2 || species > MAX_SPECIES) {
+            std::cerr << "species counts must be between 2 and " << MAX_SPECIES << std::endl;
+            return 1;
+        }
+    }
+    for (double blob_count : blob_counts) {
+        if (blob_count < 1) {
+            std::cerr << "blob counts must be at least 1" << std::endl;
+            return 1;
+        }
+    }
+    for (double density : densities) {
+        if (!(density > 0)) {
+            std::cerr << "densities must be greater than 0" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream out_file;
+    if (!out_path.empty()) {
+        out_file.open(out_path.c_str());
+        if (!out_file) {
+            std::cerr << "cannot write " << out_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = out_path.empty() ? std::cout : out_file;
+
+    // the kernel the worlds will pick, same detection as World
+    KernelIsa isa = detect_kernel_isa();
+    out << "{\n"
+        << "  \"kernel_isa\": \"" << kernel_isa_name(isa) << "\",\n"
+        << "  \"hardware_threads\": " << hardware_threads << ",\n"
+        << "  \"warmup_steps\": " << warmup_steps << ",\n"
+        << "  \"runs\": [\n";
+    bool first = true;
+    for (InteractionMode mode : modes) {
+        for (double blob_count : blob_counts) {
+            for (double species : species_counts) {
+                for (double density : densities) {
+                    for (double threads : thread_counts) {
+                        BenchConfig config;
+                        config.num_blobs = static_cast<int>(blob_count);
+                        config.num_species = static_cast<int>(species);
+                        config.density = static_cast<float>(density);
+                        config.num_threads = std::max(1, static_cast<int>(threads));
+                        config.mode = mode;
+                        config.layout = layout;
+                        if (!first) {
+                            out << ",\n";
+                        }
+                        first = false;
+                        run_config(config, max_steps, warmup_steps, max_seconds, view_fraction, out);
+                    }
+                }
+            }
+        }
+    }
+    out << "\n  ]\n}\n";
+    return 0;
+}
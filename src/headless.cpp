@@ -0,0 +1,76 @@
+// Runs the simulation without a window and reports how many steps per second it manages.
+// Builds without SFML, so it runs on machines without a display or the SFML libraries.
+//
+// usage: headless [steps] [blobs] [species] [threads] [trace_steps] [seed]
+//
+// With trace_steps, the last trace_steps steps are also written to
+// headless_trace.json as Chrome trace events. With a seed, the world runs in
+// deterministic mode and the checksum of the final state is printed, which is
+// the same for any thread count.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "sim/world.hpp"
+
+int main(int argc, char* argv[]) {
+    WorldParams params;
+    int num_steps = argc > 1 ? std::atoi(argv[1]) : 1000;
+    params.num_blobs = argc > 2 ? std::atoi(argv[2]) : 5000;
+    params.num_species = argc > 3 ? std::atoi(argv[3]) : 4;
+    params.num_threads = argc > 4 ? std::atoi(argv[4]) : std::max(1u, std::thread::hardware_concurrency());
+    int trace_steps = argc > 5 ? std::atoi(argv[5]) : 0;
+    if (argc > 6) {
+        params.deterministic = true;
+        params.seed = std::strtoul(argv[6], nullptr, 10);
+    }
+    if (num_steps < 1 || params.num_blobs < 1 || params.num_species < 2 || params.num_species > MAX_SPECIES || params.num_threads < 1 ||
+        trace_steps < 0 || trace_steps > num_steps) {
+        std::cout << "usage: headless [steps] [blobs] [species 2-" << MAX_SPECIES << "] [threads] [trace_steps] [seed]" << std::endl;
+        return 1;
+    }
+
+    // no mouse without a window
+    std::chrono::steady_clock::time_point init_start = std::chrono::steady_clock::now();
+    World world(params);
+    double init_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - init_start).count();
+    TraceRecorder tracer(params.num_threads);
+    world.set_trace_recorder(&tracer);
+
+    std::cout << "Blobs: " << params.num_blobs << ", species: " << params.num_species << ", threads: " << params.num_threads
+              << ", kernel: " << kernel_isa_name(world.kernel_isa()) << std::endl;
+    std::cout << "Initialized in " << init_seconds << " s" << std::endl;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    world.step(num_steps - trace_steps);
+    if (trace_steps > 0) {
+        tracer.start(trace_steps);
+        for (int s = 0; s < trace_steps; ++s) {
+            world.step();
+            tracer.end_frame();
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << num_steps << " steps in " << seconds << " s, " << num_steps / seconds << " steps/sec" << std::endl;
+    if (params.deterministic) {
+        char checksum[17];
+        std::snprintf(checksum, sizeof(checksum), "%016llx", static_cast<unsigned long long>(world.checksum()));
+        std::cout << "Checksum: " << checksum << std::endl;
+    }
+    if (params.work_stealing) {
+        std::cout << "Stolen tasks per thread:";
+        for (int t = 0; t < params.num_threads; ++t) {
+            std::cout << " " << world.scheduler().stolen_tasks(t) << "/" << world.scheduler().executed_tasks(t);
+        }
+        std::cout << std::endl;
+    }
+    if (trace_steps > 0 && tracer.write_chrome_json("headless_trace.json")) {
+        std::cout << "Wrote headless_trace.json" << std::endl;
+    }
+    return 0;
+}
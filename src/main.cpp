@@ -1,254 +1,419 @@
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
 #include <cmath>
 #include <SFML/Graphics.hpp>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <random>
 #include <thread>
 
-const int NUM_SPECIES = 4;
-const int NUM_BLOBS = 5000;
-const float MAX_FORCE = 0.05f;
-const float MAX_DIST = 30.0f;
-const float FRICTION = 0.9f;
-const float BLOB_SIZE = 2.5f;
-const float REPULSION_DIST = 5.0f;
-const float REPULSION_FORCE = 0.9f;
+#include "sim/triple_buffer.hpp"
+#include "sim/world.hpp"
+
+// usage: main [species] [blobs] [splat_blobs_per_pixel] [world_size]
+const int DEFAULT_NUM_SPECIES = 4;  // 2 to MAX_SPECIES
+const int DEFAULT_NUM_BLOBS = 5000;
+const float DEFAULT_WORLD_SIZE = 1000.0f;  // square, in world units
+const unsigned int WINDOW_SIZE = 1000;  // initial, in pixels
+// above this many blobs per screen pixel the blobs are drawn as a density image instead of quads
+const float DEFAULT_SPLAT_BLOBS_PER_PIXEL = 0.25f;
+const unsigned int MAX_THREADS = 6;
+const int MAX_FILL_THREADS = 4;
+const int TRACE_FRAMES = 120;  // frames written to trace.json after pressing T
+const double STEP_SECONDS = 1.0 / 60.0;  // simulated time per step
+const int MAX_SUBSTEPS = 8;  // steps per batch at most, any further backlog is dropped
+const int TURBO_STEPS = 32;  // steps per published snapshot in turbo mode (F)
+const float ZOOM_STEP = 1.1f;  // per mouse wheel notch
+const float MAX_ZOOM = 64.0f;  // window pixels per world unit
+const float PAN_STEP = 0.1f;  // of the view, per arrow key press
+
+// what the simulation thread publishes after every step
+struct SimFrame {
+    WorldSnapshot world;
+    long long steps = 0;
+    std::vector<long long> stolen_tasks;  // per pool thread, since the start
+};
 
-int WINDOW_WIDTH = 1000;
-int WINDOW_HEIGHT = 1000;
-unsigned int num_threads = 6;
+// input gathered by the render thread, applied by the simulation thread before its next step
+struct SimControls {
+    std::mutex mutex;
+    float mouse_x = 0.0f;
+    float mouse_y = 0.0f;
+    bool mouse_enabled = false;
+    bool new_rules = false;
+    bool toggle_boundary = false;
+    bool turbo = false;
+    std::atomic<bool> quit{false};
+};
 
-std::vector<std::vector<float> > rule_matrix(NUM_SPECIES, std::vector<float>(NUM_SPECIES));
-std::vector<sf::Color> species_colors(NUM_SPECIES);
+// The simulation thread: advances the world by STEP_SECONDS per step of
+// wall-clock time, running the steps that are due as one batch (at most
+// MAX_SUBSTEPS, so a slow machine drops time instead of falling ever further
+// behind), and publishes after every batch whether or not the render thread
+// is ready for it. In turbo mode it steps as fast as it can and publishes
+// every TURBO_STEPS steps.
+void simulate(World& world, SimControls& controls, TripleBuffer<SimFrame>& frames) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point last_time = Clock::now();
+    double accumulator = 0.0;
+    while (!controls.quit.load()) {
+        bool turbo;
+        {
+            std::lock_guard<std::mutex> lock(controls.mutex);
+            world.set_mouse(controls.mouse_x, controls.mouse_y, controls.mouse_enabled);
+            if (controls.new_rules) {
+                world.randomize_rules();
+                controls.new_rules = false;
+            }
+            if (controls.toggle_boundary) {
+                world.set_boundary(world.params().boundary == Boundary::Bounce ? Boundary::Clamp : Boundary::Bounce);
+                controls.toggle_boundary = false;
+            }
+            turbo = controls.turbo;
+        }
 
-float random_float(float min, float max) {
-    return min + static_cast <float> (rand()) /( static_cast <float> (RAND_MAX/(max-min)));
+        Clock::time_point now = Clock::now();
+        accumulator += std::chrono::duration<double>(now - last_time).count();
+        last_time = now;
+        int num_steps;
+        if (turbo) {
+            num_steps = TURBO_STEPS;
+            accumulator = 0.0;
+        }
+        else {
+            num_steps = static_cast<int>(accumulator / STEP_SECONDS);
+            if (num_steps == 0) {
+                std::this_thread::sleep_for(std::chrono::duration<double>(STEP_SECONDS - accumulator));
+                continue;
+            }
+            if (num_steps > MAX_SUBSTEPS) {
+                num_steps = MAX_SUBSTEPS;
+                accumulator = 0.0;
+            }
+            else {
+                accumulator -= num_steps * STEP_SECONDS;
+            }
+        }
+        world.step(num_steps);
+
+        SimFrame& frame = frames.write_buffer();
+        world.snapshot(frame.world);
+        frame.steps = world.steps_taken();
+        frame.stolen_tasks.resize(world.pool().size());
+        for (int t = 0; t < world.pool().size(); ++t) {
+            frame.stolen_tasks[t] = world.scheduler().stolen_tasks(t);
+        }
+        frames.publish();
+    }
 }
 
-int random_int(int min, int max) {
-    return min + static_cast <int> (rand()) /( static_cast <int> (RAND_MAX/(max-min)));
+// frame breakdown for the overlay: p50/p99 of the whole frame and of every section
+std::string profile_summary(const Profiler& profiler) {
+    char line[128];
+    std::snprintf(line, sizeof(line), "FPS: %d  frame p50 %.2f ms  p99 %.2f ms\n",
+                  static_cast<int>(1.0 / std::max(profiler.frame_percentile(50), 1e-6)),
+                  profiler.frame_percentile(50) * 1e3, profiler.frame_percentile(99) * 1e3);
+    std::string summary = line;
+    for (int section = 0; section < profiler.num_sections(); ++section) {
+        std::snprintf(line, sizeof(line), "%-12s p50 %6.2f ms  p99 %6.2f ms\n", profiler.section_name(section).c_str(),
+                      profiler.section_percentile(section, 50) * 1e3, profiler.section_percentile(section, 99) * 1e3);
+        summary += line;
+    }
+    return summary;
 }
 
-void generate_rules() {
-    for (int i = 0; i < NUM_SPECIES; ++i) {
-        for (int j = 0; j < NUM_SPECIES; ++j) {
-            rule_matrix[i][j] = random_float(-MAX_FORCE, MAX_FORCE);  // any force between different species
-        }
+// simulation rate and the tasks each thread stole from the others since the previous call
+std::string sim_summary(const SimFrame& frame, SimFrame& previous, float seconds, bool turbo) {
+    char line[128];
+    double steps_per_second = (frame.steps - previous.steps) / seconds;
+    std::snprintf(line, sizeof(line), "sim: %d steps/s (%.1fx real time)%s\n", static_cast<int>(steps_per_second),
+                  steps_per_second * STEP_SECONDS, turbo ? " turbo" : "");
+    std::string summary = line;
+    summary += "stolen tasks:";
+    for (size_t t = 0; t < frame.stolen_tasks.size(); ++t) {
+        long long before = t < previous.stolen_tasks.size() ? previous.stolen_tasks[t] : 0;
+        summary += " " + std::to_string(frame.stolen_tasks[t] - before);
     }
+    previous.steps = frame.steps;
+    previous.stolen_tasks = frame.stolen_tasks;
+    return summary + "\n";
 }
 
-void generate_colors() {
-    for (int i = 0; i < NUM_SPECIES; ++i) {
-        species_colors[i] = sf::Color(random_int(0, 255), random_int(0, 255), random_int(0, 255));
+// the generation-th set of colors of the seed
+void generate_colors(std::vector<sf::Color>& species_colors, int num_species, uint64_t seed, uint32_t generation) {
+    RandomStream random(seed, random_stream(RandomPurpose::Colors, 0, generation));
+    species_colors.resize(num_species);
+    for (int i = 0; i < num_species; ++i) {
+        species_colors[i] = sf::Color(random.uniform_int(0, 255), random.uniform_int(0, 255), random.uniform_int(0, 255));
     }
 }
 
-class Blob {
-public:
-    Blob(sf::Vector2f position, int species_id)
-        : position(position), species_id(species_id) {
-            velocity = sf::Vector2f(0.f, 0.f);
-            // random small velocity
-            velocity.x = random_float(-1.0f, 1.0f);
-            velocity.y = random_float(-1.0f, 1.0f);
-            size = BLOB_SIZE;
-        }
-    
-    void interact_with(Blob other_blob) {
-        // calculate the distance between the two blobs
-        sf::Vector2f dist = other_blob.getPosition() - position;
-        float length = sqrt(dist.x * dist.x + dist.y * dist.y);
-        float peak_force = rule_matrix[species_id][other_blob.species_id];
-        float force;
-        float min_dist = size + other_blob.size + REPULSION_DIST;
-        // if the distance is less than the max distance, interact
-        if (length == 0) {  // don't divide by zero (interacting with self)
-            return;
-        }
-        else if (length < min_dist) {
-            force = REPULSION_FORCE * (length / min_dist) - REPULSION_FORCE;
-        }
-        else if (length < (min_dist + MAX_DIST)/2) {
-            force = peak_force * (length - min_dist) / ((min_dist + MAX_DIST) / 2 - min_dist);
-        }
-        else if (length < MAX_DIST) {
-            force = peak_force * (MAX_DIST - length) / (MAX_DIST - (min_dist + MAX_DIST) / 2);
-        }
-        else {
-            return;
-        }
-        // apply the force to the velocity
-        sf::Vector2f force_vector = dist / length * force;
-        velocity += force_vector;
-    }
+void draw_blob(sf::RenderWindow& window, const WorldSnapshot& blobs, const std::vector<sf::Color>& species_colors, float radius, int i) {
+    sf::CircleShape shape;
+    shape.setFillColor(species_colors[blobs.species[i]]);
+    shape.setRadius(radius);
+    shape.setPosition(blobs.x[i], blobs.y[i]);
+    window.draw(shape);
+}
 
-    void interact_with_mouse(sf::Vector2f mousePos, float force) {
-        // calculate the distance between the two blobs
-        sf::Vector2f dist = mousePos - position;
-        float length = sqrt(dist.x * dist.x + dist.y * dist.y);
-        // if the distance is less than the max distance, interact
-        if (length == 0) {  // don't divide by zero
-            return;
-        }
-        else if (length < MAX_DIST) {
-            // apply the force to the velocity
-            sf::Vector2f force_vector = dist / length * force;
-            velocity += force_vector;
-        }
+// Blob quads for the GPU, kept across frames in a stream-mode vertex buffer.
+// The CPU copy gets its texcoords once in init_blob_vertices(); after that a
+// frame only writes positions, plus the colors of quads whose species changed
+// or of every quad after new colors. The visible blobs are packed into the
+// first num_quads quads in cell order, so a quad holds a different blob from
+// one frame to the next, but neighbors mostly share a species: with 4 species
+// about 60% of the quads keep theirs between frames.
+struct BlobVertices {
+    std::vector<sf::Vertex> vertices;
+    std::vector<uint8_t> drawn_species;  // species each quad is colored for
+    sf::VertexBuffer buffer{sf::Quads, sf::VertexBuffer::Stream};
+    bool colors_dirty = true;
+    int num_quads = 0;
+};
+
+const uint8_t NO_SPECIES = 255;  // quad not colored yet
+
+void init_blob_vertices(BlobVertices& blob_vertices, int num_blobs) {
+    float texture_size = 1024.0f;
+    blob_vertices.vertices.resize(num_blobs * 4);
+    for (int i = 0; i < num_blobs; ++i) {
+        sf::Vertex* quad = &blob_vertices.vertices[i * 4];
+        quad[0].texCoords = {0.0f        , 0.0f};
+        quad[1].texCoords = {texture_size, 0.0f};
+        quad[2].texCoords = {texture_size, texture_size};
+        quad[3].texCoords = {0.0f        , texture_size};
     }
+    blob_vertices.drawn_species.assign(num_blobs, NO_SPECIES);
+    blob_vertices.buffer.create(blob_vertices.vertices.size());
+}
 
-    // interact with other blobs
-    void interact(std::vector<Blob>& blobs) {
-        // loop through all other blobs
-        for (auto& other_blob : blobs) {
-            interact_with(other_blob);
+// write the quads of blobs [start, end) into the vertices, from quad first_quad on
+void fill_blob_vertices(const WorldSnapshot& blobs, const std::vector<sf::Color>& species_colors, float radius,
+                        BlobVertices& blob_vertices, int start, int end, int first_quad) {
+    for (int i = start; i < end; ++i) {
+        int q = first_quad + i - start;
+        sf::Vertex* quad = &blob_vertices.vertices[q * 4];
+        sf::Vector2f pos(blobs.x[i], blobs.y[i]);
+        quad[0].position = pos + sf::Vector2f(-radius, -radius);
+        quad[1].position = pos + sf::Vector2f(radius, -radius);
+        quad[2].position = pos + sf::Vector2f(radius, radius);
+        quad[3].position = pos + sf::Vector2f(-radius, radius);
+
+        uint8_t species = blobs.species[i];
+        if (blob_vertices.colors_dirty || blob_vertices.drawn_species[q] != species) {
+            sf::Color color = species_colors[species];
+            quad[0].color = color;
+            quad[1].color = color;
+            quad[2].color = color;
+            quad[3].color = color;
+            blob_vertices.drawn_species[q] = species;
         }
     }
+}
 
-    void update() {
-        // Update the blob's position based on its velocity
-        position += velocity;
-
-        // Apply friction to the velocity
-        velocity *= FRICTION;
+// Quads [first_quad, last_quad) of the blobs in the window, where row_quads[n]
+// is the first quad of row n (num_rows + 1 entries). The rows go side by side,
+// so the visible blobs fill the first row_quads[num_rows] quads.
+void fill_visible_blob_vertices(const WorldSnapshot& blobs, const std::vector<sf::Color>& species_colors, float radius,
+                                const CellWindow& cells, const std::vector<int>& row_quads,
+                                BlobVertices& blob_vertices, int first_quad, int last_quad) {
+    // the last row starting at or before first_quad, skipping empty rows
+    int n = std::upper_bound(row_quads.begin(), row_quads.end(), first_quad) - row_quads.begin() - 1;
+    for (int quad = first_quad; quad < last_quad; ++n) {
+        int row_last_quad = std::min(row_quads[n + 1], last_quad);
+        int start = row_begin(blobs, cells, n) + quad - row_quads[n];
+        fill_blob_vertices(blobs, species_colors, radius, blob_vertices, start, start + row_last_quad - quad, quad);
+        quad = row_last_quad;
+    }
+}
 
-        // bounce off walls
-        if (position.x < 0.0f) {
-            position.x = 0.0f;
-            velocity.x *= -1.0f;
-        }
-        if (position.x > WINDOW_WIDTH) {
-            position.x = WINDOW_WIDTH;
-            velocity.x *= -1.0f;
-        }
-        if (position.y < 0.0f) {
-            position.y = 0.0f;
-            velocity.y *= -1.0f;
-        }
-        if (position.y > WINDOW_HEIGHT) {
-            position.y = WINDOW_HEIGHT;
-            velocity.y *= -1.0f;
+// the vertices must already be filled by fill_blob_vertices
+void draw_blobs(sf::RenderWindow& window, const WorldSnapshot& blobs, const std::vector<sf::Color>& species_colors, float radius,
+                const BlobVertices& blob_vertices, sf::Texture& texture) {
+    // 0 for superfast vertex buffer blobs
+    if (0) {
+        for (size_t i = 0; i < blobs.x.size(); ++i) {
+            draw_blob(window, blobs, species_colors, radius, i);
         }
     }
-
-    void draw(sf::RenderWindow& window) const {
-        sf::CircleShape shape;
-        shape.setFillColor(species_colors[species_id]);
-        // shape.setFillColor(color);
-        shape.setRadius(size);
-        shape.setPosition(position.x, position.y);
-        window.draw(shape);
+    else if (sf::VertexBuffer::isAvailable()) {
+        window.draw(blob_vertices.buffer, 0, blob_vertices.num_quads * 4, &texture);
     }
-
-    sf::Color getColor() const {
-        return species_colors[species_id];
+    else {
+        window.draw(blob_vertices.vertices.data(), blob_vertices.num_quads * 4, sf::Quads, &texture);
     }
+}
 
-    sf::Vector2f getPosition() const {
-        return position;
-    }
+enum class LodMode {
+    Auto,   // quads, or the density splat once the blobs get denser than the threshold
+    Quads,
+    Splat,
+};
 
-    float getSize() const {
-        return size;
+const char* lod_mode_name(LodMode mode) {
+    switch (mode) {
+        case LodMode::Quads: return "quads";
+        case LodMode::Splat: return "splat";
+        default: return "auto";
     }
+}
 
-private:
-    
-    sf::Vector2f velocity;
-    int species_id;
-    sf::Vector2f position;
-    float size;
+// Level of detail for more blobs than pixels: every blob in view is counted
+// into the screen pixel it lands on, with the color sums of the species, and
+// the image is tone-mapped and drawn as one texture. Uploading and drawing
+// then cost O(pixels) whatever the blob count.
+//
+// The fill threads each own a band of rows and scan the grid cells the band
+// overlaps for the blobs landing in it, so no two threads write the same pixel
+// and the band can be tone-mapped by the same thread right away.
+struct DensitySplat {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> sums;     // red, green and blue sums and the blob count, per pixel
+    std::vector<sf::Uint8> pixels;  // RGBA
+    sf::Texture texture;
+    sf::Sprite sprite;
 };
 
-// interact a certain range of blobs with all other blobs
-void interact_blobs(std::vector<Blob>& blobs, int start, int end) {
-    for (int i = start; i < end; ++i) {
-        blobs[i].interact(blobs);
+void resize_density_splat(DensitySplat& splat, int width, int height) {
+    if (width == splat.width && height == splat.height) {
+        return;
     }
+    splat.width = width;
+    splat.height = height;
+    splat.sums.assign(width * height * 4, 0);
+    splat.pixels.assign(width * height * 4, 0);
+    splat.texture.create(width, height);
+    splat.sprite.setTexture(splat.texture, true);
 }
 
-// interact blobs in a certain grid cells with blobs in adjacent grid cells (start to end grid cell)
-void interact_blobs_grid(std::vector<Blob>& blobs, std::vector<std::vector<int> >& grid, int grid_width, int grid_height, int start_cell, int end_cell) {
-    assert(grid.size() == grid_width * grid_height);
-    
-    for (int this_cell = start_cell; this_cell < end_cell; ++this_cell) {
-        if (this_cell < 0 || this_cell >= grid_width * grid_height) {
-            continue;
-        }
-        int this_cell_x = this_cell % grid_width;
-        int this_cell_y = this_cell / grid_width;
-        for (int i = 0; i < grid[this_cell].size(); ++i) {
-            int this_blob = grid[this_cell][i];
-            for (int x = -1; x <= 1; ++x) {
-                for (int y = -1; y <=1; ++y) {
-                    int other_cell_x = this_cell_x + x;
-                    int other_cell_y = this_cell_y + y;
-                    if (other_cell_x < 0 || other_cell_x >= grid_width || other_cell_y < 0 || other_cell_y >= grid_height) {
-                        continue;
-                    }
-                    int other_cell = other_cell_y * grid_width + other_cell_x;
-                    for (int j = 0; j < grid[other_cell].size(); ++j) {
-                        int other_blob = grid[other_cell][j];
-                        if (other_blob == this_blob) {
-                            continue;
-                        }
-                        // std::cout << "interacting " << this_blob << " " << other_blob << std::endl;
-                        blobs[this_blob].interact_with(blobs[other_blob]);
-                    }
-                }
+// splat the blobs that land in rows [first_row, last_row) of the view, then tone-map those rows;
+// a pixel with reference_count blobs or more is drawn at full brightness
+void splat_rows(const WorldSnapshot& blobs, const std::vector<sf::Color>& species_colors, const sf::FloatRect& view,
+                float reference_count, DensitySplat& splat, int first_row, int last_row) {
+    std::fill(splat.sums.begin() + first_row * splat.width * 4, splat.sums.begin() + last_row * splat.width * 4, 0);
+    float scale_x = splat.width / view.width;
+    float scale_y = splat.height / view.height;
+    sf::FloatRect band(view.left, view.top + first_row / scale_y, view.width, (last_row - first_row) / scale_y);
+    CellWindow cells = cells_in_rect(blobs, band.left, band.top, band.width, band.height);
+    for (int n = 0; n < cells.num_rows(); ++n) {
+        for (int i = row_begin(blobs, cells, n); i < row_end(blobs, cells, n); ++i) {
+            float row = (blobs.y[i] - view.top) * scale_y;
+            if (row < first_row || row >= last_row) {
+                continue;
+            }
+            float column = (blobs.x[i] - view.left) * scale_x;
+            if (column < 0.0f || column >= splat.width) {
+                continue;
             }
+            uint32_t* sum = &splat.sums[(static_cast<int>(row) * splat.width + static_cast<int>(column)) * 4];
+            sf::Color color = species_colors[blobs.species[i]];
+            sum[0] += color.r;
+            sum[1] += color.g;
+            sum[2] += color.b;
+            sum[3] += 1;
         }
     }
 
+    float log_reference = std::log1p(reference_count);
+    for (int p = first_row * splat.width; p < last_row * splat.width; ++p) {
+        const uint32_t* sum = &splat.sums[p * 4];
+        sf::Uint8* pixel = &splat.pixels[p * 4];
+        if (sum[3] == 0) {
+            pixel[0] = pixel[1] = pixel[2] = pixel[3] = 0;
+            continue;
+        }
+        // the average color of the blobs in the pixel, brighter the more there are
+        float brightness = std::min(1.0f, std::log1p(static_cast<float>(sum[3])) / log_reference) / sum[3];
+        pixel[0] = static_cast<sf::Uint8>(sum[0] * brightness);
+        pixel[1] = static_cast<sf::Uint8>(sum[1] * brightness);
+        pixel[2] = static_cast<sf::Uint8>(sum[2] * brightness);
+        pixel[3] = 255;
+    }
 }
 
-void draw_blobs(sf::RenderWindow& window, std::vector<Blob>& blobs, sf::VertexArray& objects_va, sf::Texture& texture) {
-    // 0 for superfast vertex array blobs
-    if (0) {
-        for (auto& blob : blobs) {
-            blob.draw(window);
+// the part of the world the view shows
+sf::FloatRect view_rect(const sf::View& view) {
+    return sf::FloatRect(view.getCenter() - view.getSize() / 2.0f, view.getSize());
+}
+
+// Where the window looks: the world point at its center and the window pixels
+// per world unit. The view follows from the window size, so resizing the
+// window shows more or less of the world at the same scale.
+struct Camera {
+    sf::Vector2f center;
+    float zoom = 1.0f;
+    float min_zoom = 1.0f;  // half the zoom that fits the world
+};
+
+void fit_camera(Camera& camera, float world_width, float world_height, sf::Vector2u window_size) {
+    camera.center = sf::Vector2f(world_width / 2.0f, world_height / 2.0f);
+    camera.zoom = std::min(window_size.x / world_width, window_size.y / world_height);
+    camera.min_zoom = camera.zoom / 2.0f;
+}
+
+sf::View camera_view(const Camera& camera, sf::Vector2u window_size) {
+    return sf::View(camera.center, sf::Vector2f(window_size.x / camera.zoom, window_size.y / camera.zoom));
+}
+
+// move the camera by offset (in world units), keeping its center in the world
+void pan_camera(Camera& camera, sf::Vector2f offset, float world_width, float world_height) {
+    camera.center.x = std::min(std::max(camera.center.x + offset.x, 0.0f), world_width);
+    camera.center.y = std::min(std::max(camera.center.y + offset.y, 0.0f), world_height);
+}
+
+// zoom by factor, keeping the world point at anchor where it is on screen
+void zoom_camera(Camera& camera, float factor, sf::Vector2f anchor) {
+    float zoom = std::min(std::max(camera.zoom * factor, camera.min_zoom), MAX_ZOOM);
+    camera.center = anchor + (camera.center - anchor) * (camera.zoom / zoom);
+    camera.zoom = zoom;
+}
+
+int main(int argc, char* argv[])
+{
+    WorldParams params;
+    params.num_blobs = argc > 2 ? std::atoi(argv[2]) : DEFAULT_NUM_BLOBS;
+    params.num_species = DEFAULT_NUM_SPECIES;
+    float splat_blobs_per_pixel = argc > 3 ? std::atof(argv[3]) : DEFAULT_SPLAT_BLOBS_PER_PIXEL;
+    params.world_width = params.world_height = argc > 4 ? std::atof(argv[4]) : DEFAULT_WORLD_SIZE;
+    if (argc > 1) {
+        params.num_species = std::atoi(argv[1]);
+        if (params.num_species < 2 || params.num_species > MAX_SPECIES) {
+            std::cout << "Number of species must be between 2 and " << MAX_SPECIES << std::endl;
+            return 1;
         }
     }
-    else {
-        float texture_size = 1024.0f;
-        for (uint32_t i = 0; i < blobs.size(); ++i) {
-                const Blob& object = blobs[i];
-                const uint32_t idx = i << 2;
-                const float radius = object.getSize();
-                sf::Color color = object.getColor();
-                sf::Vector2f pos = object.getPosition();
-                objects_va[idx + 0].position = pos + sf::Vector2f(-radius, -radius);
-                objects_va[idx + 1].position = pos + sf::Vector2f(radius, -radius);
-                objects_va[idx + 2].position = pos + sf::Vector2f(radius, radius);
-                objects_va[idx + 3].position = pos + sf::Vector2f(-radius, radius);
-                objects_va[idx + 0].texCoords = {0.0f        , 0.0f};
-                objects_va[idx + 1].texCoords = {texture_size, 0.0f};
-                objects_va[idx + 2].texCoords = {texture_size, texture_size};
-                objects_va[idx + 3].texCoords = {0.0f        , texture_size};
-
-                objects_va[idx + 0].color = color;
-                objects_va[idx + 1].color = color;
-                objects_va[idx + 2].color = color;
-                objects_va[idx + 3].color = color;
-            }
-        window.draw(objects_va, &texture);
+    if (params.num_blobs < 1) {
+        std::cout << "Number of blobs must be at least 1" << std::endl;
+        return 1;
+    }
+    if (params.world_width < params.max_dist) {
+        std::cout << "World size must be at least " << params.max_dist << std::endl;
+        return 1;
     }
-    
-}
 
-int main()
-{
-    sf::RenderWindow window(sf::VideoMode(WINDOW_WIDTH, WINDOW_HEIGHT), "SFML test 2!");
+    sf::RenderWindow window(sf::VideoMode(WINDOW_SIZE, WINDOW_SIZE), "SFML test 2!");
+    // the blobs are drawn through the camera, the overlay in window pixels
+    Camera camera;
+    fit_camera(camera, params.world_width, params.world_height, window.getSize());
+    sf::View hud_view(sf::FloatRect(0, 0, WINDOW_SIZE, WINDOW_SIZE));
+    bool dragging = false;
+    sf::Vector2i drag_position;
     // sf::CircleShape shape(50.f);
     // shape.setFillColor(sf::Color::Yellow);
 
     sf::Font font;
-    
+
     if ( !font.loadFromFile( "res/fonts/ComicSansMS3.ttf" ) )
     {
         std::cout << "Error loading file" << std::endl;
-        
+
         //system( "pause" );
     }
     sf::Text text;
@@ -257,141 +422,276 @@ int main()
     text.setFillColor(sf::Color::White);
     text.setPosition(10.0f, 10.0f);
 
-    #include <algorithm> // Add this line to include the <algorithm> header for std::max
-
-    sf::VertexArray objects_va(sf::Quads, NUM_BLOBS * 4);
+    BlobVertices blob_vertices;
+    init_blob_vertices(blob_vertices, params.num_blobs);
+    std::vector<int> row_quads;  // first quad of every visible cell row
+    DensitySplat splat;
+    LodMode lod_mode = LodMode::Auto;
     sf::Texture texture;
     texture.loadFromFile("res/images/circle.png");
 
     // print number of threads available
-    std::vector<std::thread> threads;
-    num_threads = std::min(std::thread::hardware_concurrency(), num_threads);
-    std::cout << "Number of threads: " << num_threads << std::endl;
+    params.num_threads = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_THREADS));
+    std::cout << "Number of threads: " << params.num_threads << std::endl;
 
-    // For calculating FPS
+    // For refreshing the overlay, the percentiles sort the whole history so not every frame
     sf::Clock fps_clock;
-    sf::Clock timer_clock;
     float timeSinceLastUpdate = 0.f;
-    int fps = 150;
-    float timePerFrame = 1.f / fps; // 60 fps
-    // window.setFramerateLimit(fps); // comment this our to uncap
-
-    // create a vector of blobs, randomizing their positions and colors
-    generate_colors();
-    generate_rules();
-    
-    std::vector<Blob> blobs;
-    for (int i = 0; i < NUM_BLOBS; ++i) {
-        sf::Vector2f position = sf::Vector2f(random_float(0.0f, WINDOW_WIDTH), random_float(0.0f, WINDOW_HEIGHT));
-        int species_id = random_int(0, NUM_SPECIES);
-        Blob blob = Blob(position, species_id);
-        blobs.push_back(blob);
+    float timePerUpdate = 0.25f;
+    // window.setFramerateLimit(150); // comment this our to uncap
+
+    // create the world, randomizing blob positions, rules and colors
+    std::vector<sf::Color> species_colors;
+    uint32_t color_generation = 0;
+    generate_colors(species_colors, params.num_species, params.seed, color_generation++);
+    World world(params);
+    if (params.interaction_mode == InteractionMode::Vectorized || params.interaction_mode == InteractionMode::NeighborLists) {
+        std::cout << "Interaction kernel: " << kernel_isa_name(world.kernel_isa()) << std::endl;
+    }
+
+    // profiler thread 0 is this (render) thread, thread 1 the simulation thread, which adds
+    // its step stages between events and vertex_fill; a frame holds every step taken during it
+    const int render_profiler_thread = 0;
+    const int sim_profiler_thread = 1;
+    Profiler profiler(2);
+    int events_section = profiler.section("events");
+    world.set_profiler(&profiler, sim_profiler_thread);
+    int fill_section = profiler.section("vertex_fill");
+    int draw_section = profiler.section("draw");
+    int display_section = profiler.section("display");
+
+    // the vertex fill gets its own threads, the world's are busy with the next step;
+    // this thread takes part as the fill pool's thread 0
+    int fill_threads = std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()) - params.num_threads, MAX_FILL_THREADS));
+    ThreadPool fill_pool(fill_threads);
+
+    // per-thread phase spans for trace.json, only recorded after pressing T;
+    // the world's pool threads come first, then this thread and the other fill threads
+    const int render_thread = params.num_threads;
+    TraceRecorder tracer(params.num_threads + fill_threads);
+    tracer.set_thread_name(0, "simulation");
+    tracer.set_thread_name(render_thread, "render");
+    for (int t = 1; t < fill_threads; ++t) {
+        tracer.set_thread_name(render_thread + t, "fill " + std::to_string(t));
     }
+    world.set_trace_recorder(&tracer);
+
+    // the simulation runs on its own thread (with the world's pool) and hands
+    // snapshots over through the triple buffer, so a slow present never holds up
+    // the physics and the other way round
+    SimControls controls;
+    TripleBuffer<SimFrame> frames;
+    world.snapshot(frames.write_buffer().world);
+    frames.publish();
+    std::thread sim_thread(simulate, std::ref(world), std::ref(controls), std::ref(frames));
+    SimFrame hud_previous;
+    bool turbo = false;  // the render thread's copy of controls.turbo
 
     while (window.isOpen())
     {
+        Profiler::Clock::time_point events_start = Profiler::Clock::now();
+        // gather the input first and hand it to the simulation thread under a short
+        // lock afterwards, so nothing slow (like writing profile.csv) holds up a step
+        bool new_rules = false;
+        bool toggle_boundary = false;
+        bool write_profile = false;
         sf::Event event;
         while (window.pollEvent(event))
         {
             if (event.type == sf::Event::Closed)
                 window.close();
 
-            // Handle window resize
+            // Handle window resize: the camera keeps its zoom and shows more or less of the world
             if (event.type == sf::Event::Resized)
             {
-                // Create a new view with the size of the window
-                sf::FloatRect visibleArea(0, 0, event.size.width, event.size.height);
-                window.setView(sf::View(visibleArea));
-                WINDOW_WIDTH = event.size.width;
-                WINDOW_HEIGHT = event.size.height;
+                hud_view.reset(sf::FloatRect(0, 0, event.size.width, event.size.height));
+            }
+            // the wheel zooms around the cursor, dragging with the right button pans
+            if (event.type == sf::Event::MouseWheelScrolled && event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+                sf::Vector2i pixel(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+                sf::Vector2f anchor = window.mapPixelToCoords(pixel, camera_view(camera, window.getSize()));
+                zoom_camera(camera, std::pow(ZOOM_STEP, event.mouseWheelScroll.delta), anchor);
+            }
+            if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Right) {
+                dragging = true;
+                drag_position = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+            }
+            if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Right) {
+                dragging = false;
+            }
+            if (event.type == sf::Event::MouseMoved && dragging) {
+                sf::Vector2i position(event.mouseMove.x, event.mouseMove.y);
+                sf::Vector2f offset(drag_position - position);
+                pan_camera(camera, offset / camera.zoom, params.world_width, params.world_height);
+                drag_position = position;
             }
             if (event.type == sf::Event::KeyPressed) {
                 // Check if the key pressed is the "R" key
                 if (event.key.code == sf::Keyboard::R) {
-                    generate_rules();
+                    new_rules = true;
                 }
                 if (event.key.code == sf::Keyboard::C) {
-                    generate_colors();
+                    generate_colors(species_colors, params.num_species, params.seed, color_generation++);
+                    blob_vertices.colors_dirty = true;
+                }
+                if (event.key.code == sf::Keyboard::B) {
+                    toggle_boundary = true;
+                }
+                if (event.key.code == sf::Keyboard::F) {
+                    turbo = !turbo;
+                }
+                if (event.key.code == sf::Keyboard::L) {
+                    lod_mode = lod_mode == LodMode::Auto ? LodMode::Quads : lod_mode == LodMode::Quads ? LodMode::Splat : LodMode::Auto;
+                }
+                if (event.key.code == sf::Keyboard::P) {
+                    write_profile = true;
+                }
+                if (event.key.code == sf::Keyboard::T && !tracer.recording()) {
+                    tracer.start(TRACE_FRAMES);
+                }
+                if (event.key.code == sf::Keyboard::Home) {
+                    fit_camera(camera, params.world_width, params.world_height, window.getSize());
+                }
+                sf::Vector2f pan_step = camera_view(camera, window.getSize()).getSize() * PAN_STEP;
+                if (event.key.code == sf::Keyboard::Left) {
+                    pan_camera(camera, sf::Vector2f(-pan_step.x, 0.0f), params.world_width, params.world_height);
                 }
+                if (event.key.code == sf::Keyboard::Right) {
+                    pan_camera(camera, sf::Vector2f(pan_step.x, 0.0f), params.world_width, params.world_height);
+                }
+                if (event.key.code == sf::Keyboard::Up) {
+                    pan_camera(camera, sf::Vector2f(0.0f, -pan_step.y), params.world_width, params.world_height);
+                }
+                if (event.key.code == sf::Keyboard::Down) {
+                    pan_camera(camera, sf::Vector2f(0.0f, pan_step.y), params.world_width, params.world_height);
+                }
+            }
+        }
+
+        window.setView(camera_view(camera, window.getSize()));
+
+        // Get the current position of the mouse, it only pushes blobs while it can reach them
+        sf::Vector2f mousePos = window.mapPixelToCoords(sf::Mouse::getPosition(window));
+        float reach = params.max_dist;
+        bool mouse_enabled = window.hasFocus() && mousePos.x > -reach && mousePos.x < params.world_width + reach &&
+                             mousePos.y > -reach && mousePos.y < params.world_height + reach;
+        {
+            std::lock_guard<std::mutex> lock(controls.mutex);
+            controls.mouse_x = mousePos.x;
+            controls.mouse_y = mousePos.y;
+            controls.mouse_enabled = mouse_enabled;
+            if (new_rules) {
+                controls.new_rules = true;
+            }
+            if (toggle_boundary) {
+                controls.toggle_boundary = true;
             }
+            controls.turbo = turbo;
         }
+        if (write_profile && profiler.write_csv("profile.csv")) {
+            std::cout << "Wrote profile.csv" << std::endl;
+        }
+        Profiler::Clock::time_point events_end = Profiler::Clock::now();
+        profiler.record(render_profiler_thread, events_section, events_start, events_end);
+        tracer.record(render_thread, "events", events_start, events_end);
+
+        // the newest complete step, or the one drawn last frame if the simulation has not finished another
+        frames.acquire();
+        const SimFrame& frame = frames.read_buffer();
+
+        // blobs per screen pixel at the current zoom, assuming they are spread over the whole world
+        sf::FloatRect view = view_rect(window.getView());
+        sf::Vector2u window_size = window.getSize();
+        float blobs_per_pixel = params.num_blobs / (params.world_width * params.world_height) / (camera.zoom * camera.zoom);
+        bool use_splat = lod_mode == LodMode::Splat || (lod_mode == LodMode::Auto && blobs_per_pixel > splat_blobs_per_pixel);
 
          // Update the scene
         float elapsedTime = fps_clock.restart().asSeconds();
         timeSinceLastUpdate += elapsedTime;
-        if (timeSinceLastUpdate > timePerFrame)
+        if (timeSinceLastUpdate > timePerUpdate)
         {
-            // Calculate FPS
-            float fps = 1.f / elapsedTime;
-            text.setString("FPS: " + std::to_string(static_cast<int>(fps)));
+            char lod_line[128];
+            std::snprintf(lod_line, sizeof(lod_line), "LOD %s: %s, %.3f blobs/pixel\n", lod_mode_name(lod_mode),
+                          use_splat ? "splat" : "quads", blobs_per_pixel);
+            text.setString(profile_summary(profiler) + sim_summary(frame, hud_previous, timeSinceLastUpdate, turbo) + lod_line);
 
             // Reset the timeSinceLastUpdate
             timeSinceLastUpdate = 0.f;
         }
-        int cell_height = MAX_DIST;  // in pixels
-        int cell_width = MAX_DIST;  // in pixels
-        int grid_height = WINDOW_HEIGHT / cell_height + 1;  // in cells
-        int grid_width = WINDOW_WIDTH / cell_width + 1;  // in cells
-        int grid_size = grid_height * grid_width;  // in cells
-
-
-        std::vector<std::vector<int> > grid(grid_size, std::vector<int>());
-        for (int i = 0; i < blobs.size(); ++i) {
-            int grid_x = blobs[i].getPosition().x / cell_width;
-            int grid_y = blobs[i].getPosition().y / cell_height;
-            if (grid_x < 0 || grid_x > WINDOW_WIDTH / cell_width || grid_y < 0 || grid_y > WINDOW_HEIGHT / cell_height) {
-                std::cout << "blob out of bounds " << grid_x << " " << grid_y << std::endl;
-                continue;
-            }
-            // std::cout << "blob " << i << " " << grid_x << " " << grid_y << std::endl;
-            // std::cout << "grid size " << grid.size() << std::endl;
-            grid[grid_y * (WINDOW_HEIGHT / cell_height + 1) + grid_x].push_back(i);
-        }
 
-        // Get the current position of the mouse
-        sf::Vector2f mousePos = window.mapPixelToCoords(sf::Mouse::getPosition(window));
-
-        // WITH GRIDS        
-        // interact_blobs_grid(blobs, grid, grid_width, grid_height, 0, grid_size);
-
-        threads.clear();
-        for (int i = 0; i < num_threads; ++i) {
-            int start_cell = i * grid_size / num_threads;
-            int end_cell = (i + 1) * grid_size / num_threads;
-            threads.push_back(std::thread(interact_blobs_grid, std::ref(blobs), std::ref(grid), grid_width, grid_height, start_cell, end_cell));
+        if (use_splat) {
+            ScopedTimer timer(&profiler, render_profiler_thread, fill_section);
+            resize_density_splat(splat, window_size.x, window_size.y);
+            // brightest where blobs pile up to 4x the average density
+            float reference_count = std::max(4.0f * blobs_per_pixel, 1.0f);
+            fill_pool.run({[&](int t) {
+                int first_row = fill_pool.range_begin(t, splat.height);
+                int last_row = fill_pool.range_end(t, splat.height);
+                TraceRecorder::Clock::time_point splat_start = TraceRecorder::Clock::now();
+                splat_rows(frame.world, species_colors, view, reference_count, splat, first_row, last_row);
+                tracer.record(render_thread + t, "splat", splat_start, TraceRecorder::Clock::now(), first_row, last_row);
+            }});
+            splat.texture.update(splat.pixels.data());
+            splat.sprite.setPosition(view.left, view.top);
+            splat.sprite.setScale(view.width / splat.width, view.height / splat.height);
         }
-        for (auto& thread : threads) {
-            thread.join();
+        else {
+            ScopedTimer timer(&profiler, render_profiler_thread, fill_section);
+            // only the cells in view (widened by a blob so the quads on its edges are kept),
+            // the rows are counted first so the threads can split the quads evenly
+            float radius = params.blob_size;
+            sf::FloatRect culled(view.left - radius, view.top - radius, view.width + 2 * radius, view.height + 2 * radius);
+            CellWindow cells = cells_in_rect(frame.world, culled.left, culled.top, culled.width, culled.height);
+            row_quads.assign(1, 0);
+            for (int n = 0; n < cells.num_rows(); ++n) {
+                row_quads.push_back(row_quads.back() + row_end(frame.world, cells, n) - row_begin(frame.world, cells, n));
+            }
+            int num_quads = row_quads.back();
+            fill_pool.run({[&](int t) {
+                int first_quad = fill_pool.range_begin(t, num_quads);
+                int last_quad = fill_pool.range_end(t, num_quads);
+                TraceRecorder::Clock::time_point fill_start = TraceRecorder::Clock::now();
+                fill_visible_blob_vertices(frame.world, species_colors, radius, cells, row_quads, blob_vertices, first_quad, last_quad);
+                tracer.record(render_thread + t, "vertex_fill", fill_start, TraceRecorder::Clock::now(), first_quad, last_quad,
+                              last_quad - first_quad);
+            }});
+            blob_vertices.colors_dirty = false;
+            blob_vertices.num_quads = num_quads;
+            if (num_quads > 0) {
+                blob_vertices.buffer.update(blob_vertices.vertices.data(), num_quads * 4, 0);
+            }
         }
 
-        // WITHOUT GRIDS
-        // for (auto& blob : blobs) {
-        //     blob.interact(blobs);
-        // }
-        // distribute blob amongs threads and interact
-        timer_clock.restart();
-        // threads.clear();
-        // for (int i = 0; i < num_threads; ++i) {
-        //     threads.push_back(std::thread(interact_blobs, std::ref(blobs), i * NUM_BLOBS / num_threads, (i + 1) * NUM_BLOBS / num_threads));
-        // }
-        // for (auto& thread : threads) {
-        //     thread.join();
-        // }
-        for (auto& blob : blobs) {
-            blob.interact_with_mouse(mousePos, -0.5f);
+        // draw the scene
+        Profiler::Clock::time_point draw_start = Profiler::Clock::now();
+        {
+            ScopedTimer timer(&profiler, render_profiler_thread, draw_section);
+            window.clear();
+            if (use_splat) {
+                window.draw(splat.sprite);
+            }
+            else {
+                draw_blobs(window, frame.world, species_colors, params.blob_size, blob_vertices, texture);
+            }
+            window.setView(hud_view);
+            window.draw(text);
         }
-        for (auto& blob : blobs) {
-            blob.update();
+        {
+            ScopedTimer timer(&profiler, render_profiler_thread, display_section);
+            window.display();
+        }
+        tracer.record(render_thread, "draw_display", draw_start, Profiler::Clock::now());
+        profiler.end_frame();
+        tracer.end_frame(render_thread);
+        if (tracer.finished()) {
+            if (tracer.write_chrome_json("trace.json")) {
+                std::cout << "Wrote trace.json" << std::endl;
+            }
         }
-        float timer_time = timer_clock.getElapsedTime().asMicroseconds();
-        // text.setString("interact time: " + std::to_string(static_cast<int>(timer_time)));
-        
-        // draw the scene
-        window.clear();
-        draw_blobs(window, blobs, objects_va, texture);
-        window.draw(text);
-        window.display();
     }
 
+    controls.quit = true;
+    sim_thread.join();
+
     return 0;
 }
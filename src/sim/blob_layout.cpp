@@ -0,0 +1,105 @@
+#include "blob_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+const float TWO_PI = 6.28318530718f;
+
+// standard normal sample (Box-Muller, one of the pair)
+static float normal(RandomStream& random) {
+    float u = 1.0f - random.next_float();  // (0, 1], keeps log finite
+    float v = random.next_float();
+    return std::sqrt(-2.0f * std::log(u)) * std::cos(TWO_PI * v);
+}
+
+static float clamp(float value, float max) {
+    return std::min(std::max(value, 0.0f), max);
+}
+
+static void place_uniform(const LayoutArgs& args, RandomStream& random, float& x, float& y, int& species) {
+    x = random.uniform(0.0f, args.world_width);
+    y = random.uniform(0.0f, args.world_height);
+    species = random.uniform_int(0, args.num_species - 1);
+}
+
+static void place_in_cluster(const LayoutArgs& args, RandomStream& random, float& x, float& y, int& species) {
+    int cluster = random.uniform_int(0, static_cast<int>(args.center_x.size()) - 1);
+    x = clamp(args.center_x[cluster] + normal(random) * args.radius[cluster], args.world_width);
+    y = clamp(args.center_y[cluster] + normal(random) * args.radius[cluster], args.world_height);
+    species = random.uniform_int(0, args.num_species - 1);
+}
+
+static void place_on_ring(const LayoutArgs& args, RandomStream& random, float& x, float& y, int& species) {
+    int ring = random.uniform_int(0, static_cast<int>(args.center_x.size()) - 1);
+    float angle = random.uniform(0.0f, TWO_PI);
+    float radius = args.radius[ring] * (1.0f + 0.05f * normal(random));
+    x = clamp(args.center_x[ring] + std::cos(angle) * radius, args.world_width);
+    y = clamp(args.center_y[ring] + std::sin(angle) * radius, args.world_height);
+    species = random.uniform_int(0, args.num_species - 1);
+}
+
+static void place_in_region(const LayoutArgs& args, RandomStream& random, float& x, float& y, int& species) {
+    species = random.uniform_int(0, args.num_species - 1);
+    float region_width = args.world_width / args.region_columns;
+    float region_height = args.world_height / args.region_rows;
+    x = (species % args.region_columns + random.next_float()) * region_width;
+    y = (species / args.region_columns + random.next_float()) * region_height;
+}
+
+LayoutArgs make_layout_args(BlobLayout layout, int num_species, float world_width, float world_height,
+                            uint64_t seed, uint32_t generation) {
+    LayoutArgs args;
+    args.num_species = num_species;
+    args.world_width = world_width;
+    args.world_height = world_height;
+    args.region_columns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(num_species))));
+    args.region_rows = (num_species + args.region_columns - 1) / args.region_columns;
+
+    // the blobs use the streams of their slots, the shared features the last stream of the generation
+    RandomStream random(seed, random_stream(RandomPurpose::Blobs, UINT32_MAX, generation));
+    float size = std::min(world_width, world_height);
+    if (layout == BlobLayout::Clusters) {
+        int num_clusters = 2 * num_species;
+        for (int c = 0; c < num_clusters; ++c) {
+            args.center_x.push_back(random.uniform(0.0f, world_width));
+            args.center_y.push_back(random.uniform(0.0f, world_height));
+            args.radius.push_back(random.uniform(0.02f, 0.08f) * size);
+        }
+    }
+    else if (layout == BlobLayout::Rings) {
+        int num_rings = num_species;
+        for (int r = 0; r < num_rings; ++r) {
+            float radius = random.uniform(0.1f, 0.3f) * size;
+            args.center_x.push_back(random.uniform(radius, world_width - radius));
+            args.center_y.push_back(random.uniform(radius, world_height - radius));
+            args.radius.push_back(radius);
+        }
+    }
+    return args;
+}
+
+BlobPlacer select_blob_placer(BlobLayout layout) {
+    switch (layout) {
+        case BlobLayout::Clusters:
+            return place_in_cluster;
+        case BlobLayout::Rings:
+            return place_on_ring;
+        case BlobLayout::SpeciesRegions:
+            return place_in_region;
+        default:
+            return place_uniform;
+    }
+}
+
+const char* blob_layout_name(BlobLayout layout) {
+    switch (layout) {
+        case BlobLayout::Clusters:
+            return "clusters";
+        case BlobLayout::Rings:
+            return "rings";
+        case BlobLayout::SpeciesRegions:
+            return "regions";
+        default:
+            return "uniform";
+    }
+}
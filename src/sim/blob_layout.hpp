@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "random.hpp"
+
+// Initial arrangements of the blobs of a new world.
+enum class BlobLayout {
+    Uniform,         // anywhere in the world, any species
+    Clusters,        // Gaussian clusters of mixed species around random centers
+    Rings,           // thin rings around random centers, any species
+    SpeciesRegions,  // every species in its own rectangle of a grid over the world
+};
+
+// What a layout needs besides the blob's own random stream. Shared features
+// (cluster and ring centers) are drawn once per randomization by
+// make_layout_args(), so placing a blob only reads them and can happen on any
+// thread, in any order.
+struct LayoutArgs {
+    int num_species;
+    float world_width;
+    float world_height;
+    std::vector<float> center_x;  // clusters or rings
+    std::vector<float> center_y;
+    std::vector<float> radius;    // standard deviation of a cluster, radius of a ring
+    int region_columns;           // species regions
+    int region_rows;
+};
+
+// position and species of one blob, drawn from its own stream
+typedef void (*BlobPlacer)(const LayoutArgs& args, RandomStream& random, float& x, float& y, int& species);
+
+LayoutArgs make_layout_args(BlobLayout layout, int num_species, float world_width, float world_height,
+                            uint64_t seed, uint32_t generation);
+BlobPlacer select_blob_placer(BlobLayout layout);
+const char* blob_layout_name(BlobLayout layout);
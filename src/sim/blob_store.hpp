@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// std::allocator, except that construction without a value (vector::resize)
+// default-initializes, i.e. leaves numbers unwritten. A resized array's pages
+// are then first touched by the threads that fill it, not zeroed by the one
+// that resized it.
+template <class T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <class U>
+    struct rebind {
+        typedef DefaultInitAllocator<U> other;
+    };
+
+    DefaultInitAllocator() = default;
+    template <class U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) {}
+
+    template <class U>
+    void construct(U* p) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <class U, class... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
+template <class T>
+using BlobArray = std::vector<T, DefaultInitAllocator<T> >;
+
+// Structure-of-arrays blob storage. Every phase of the step only touches a few
+// fields (the neighbor scan reads x/y/species, integration reads x/y/vx/vy), so
+// keeping each field in its own contiguous array means a phase streams exactly
+// the bytes it needs instead of whole interleaved blobs.
+//
+// resize() leaves new blobs uninitialized, whoever grows the store writes them.
+struct BlobStore {
+    BlobArray<float> x;
+    BlobArray<float> y;
+    BlobArray<float> vx;
+    BlobArray<float> vy;
+    BlobArray<uint8_t> species;
+    BlobArray<uint32_t> id;
+    BlobArray<uint32_t> slot_of_id;
+
+    size_t size() const {
+        return x.size();
+    }
+
+    void reserve(size_t n) {
+        x.reserve(n);
+        y.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        species.reserve(n);
+        id.reserve(n);
+        slot_of_id.reserve(n);
+    }
+
+    void resize(size_t n) {
+        x.resize(n);
+        y.resize(n);
+        vx.resize(n);
+        vy.resize(n);
+        species.resize(n);
+        id.resize(n);
+        slot_of_id.resize(n);
+    }
+
+    void swap(BlobStore& other) {
+        x.swap(other.x);
+        y.swap(other.y);
+        vx.swap(other.vx);
+        vy.swap(other.vy);
+        species.swap(other.species);
+        id.swap(other.id);
+        slot_of_id.swap(other.slot_of_id);
+    }
+
+    void add(float pos_x, float pos_y, float vel_x, float vel_y, int species_id) {
+        x.push_back(pos_x);
+        y.push_back(pos_y);
+        vx.push_back(vel_x);
+        vy.push_back(vel_y);
+        species.push_back(static_cast<uint8_t>(species_id));
+        id.push_back(static_cast<uint32_t>(slot_of_id.size()));
+        slot_of_id.push_back(static_cast<uint32_t>(id.size() - 1));
+    }
+};
@@ -0,0 +1,139 @@
+#include "cell_kernels.hpp"
+
+#include <cstring>
+
+void interact_cells_scalar(const CellKernelArgs& args, int start_cell, int end_cell) {
+    const float max_dist_sq = args.forces.max_dist * args.forces.max_dist;
+
+    for (int cell = start_cell; cell < end_cell; ++cell) {
+        int cell_x = cell % args.grid_width;
+        int cell_y = cell / args.grid_width;
+        // the cells left and right of a neighbor row are contiguous in cell order
+        int first_x = cell_x > 0 ? cell_x - 1 : cell_x;
+        int last_x = cell_x < args.grid_width - 1 ? cell_x + 1 : cell_x;
+        int first_y = cell_y > 0 ? cell_y - 1 : cell_y;
+        int last_y = cell_y < args.grid_height - 1 ? cell_y + 1 : cell_y;
+
+        for (int i = args.cell_start[cell]; i < args.cell_start[cell + 1]; ++i) {
+            float this_x = args.x[i];
+            float this_y = args.y[i];
+            const float* profiles = args.forces.force_table + ((args.species[i] * args.forces.num_species) << args.forces.table_bits);
+            float force_x = 0.0f;
+            float force_y = 0.0f;
+            for (int row = first_y; row <= last_y; ++row) {
+                int begin = args.cell_start[row * args.grid_width + first_x];
+                int end = args.cell_start[row * args.grid_width + last_x + 1];
+                for (int j = begin; j < end; ++j) {
+                    float dist_x = args.x[j] - this_x;
+                    float dist_y = args.y[j] - this_y;
+                    float length_sq = dist_x * dist_x + dist_y * dist_y;
+                    if (length_sq >= max_dist_sq || length_sq == 0.0f) {  // out of range, or self
+                        continue;
+                    }
+                    float d2 = length_sq > args.forces.table_min_d2 ? length_sq : args.forces.table_min_d2;
+                    int32_t d2_bits;
+                    std::memcpy(&d2_bits, &d2, sizeof(d2_bits));
+                    int bin = (d2_bits - args.forces.table_offset) >> args.forces.table_shift;
+                    float force = profiles[(args.species[j] << args.forces.table_bits) + bin];  // already divided by length
+                    force_x += dist_x * force;
+                    force_y += dist_y * force;
+                }
+            }
+            int slot = args.cell_items[i];
+            args.vx[slot] += force_x;
+            args.vy[slot] += force_y;
+        }
+    }
+}
+
+void walk_lists_scalar(const ListKernelArgs& args, int start, int end) {
+    const float max_dist_sq = args.forces.max_dist * args.forces.max_dist;
+
+    for (int k = start; k < end; ++k) {
+        int slot = args.list_blob[k];
+        float this_x = args.x[slot];
+        float this_y = args.y[slot];
+        const float* profiles = args.forces.force_table + ((args.species[slot] * args.forces.num_species) << args.forces.table_bits);
+        float force_x = 0.0f;
+        float force_y = 0.0f;
+        for (int n = args.list_start[k]; n < args.list_start[k + 1]; ++n) {
+            int other = args.neighbors[n];
+            float dist_x = args.x[other] - this_x;
+            float dist_y = args.y[other] - this_y;
+            float length_sq = dist_x * dist_x + dist_y * dist_y;
+            if (length_sq >= max_dist_sq || length_sq == 0.0f) {  // in the skin, or on top of each other
+                continue;
+            }
+            float d2 = length_sq > args.forces.table_min_d2 ? length_sq : args.forces.table_min_d2;
+            int32_t d2_bits;
+            std::memcpy(&d2_bits, &d2, sizeof(d2_bits));
+            int bin = (d2_bits - args.forces.table_offset) >> args.forces.table_shift;
+            float force = profiles[(args.neighbor_species[n] << args.forces.table_bits) + bin];
+            force_x += dist_x * force;
+            force_y += dist_y * force;
+        }
+        args.vx[slot] += force_x;
+        args.vy[slot] += force_y;
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+KernelIsa detect_kernel_isa() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelIsa::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KernelIsa::SSE;
+    }
+    return KernelIsa::Scalar;
+}
+
+#else
+
+KernelIsa detect_kernel_isa() {
+    return KernelIsa::Scalar;
+}
+
+// the vector kernels are x86 only, fall back to scalar elsewhere
+void interact_cells_sse(const CellKernelArgs& args, int start_cell, int end_cell) {
+    interact_cells_scalar(args, start_cell, end_cell);
+}
+
+void interact_cells_avx2(const CellKernelArgs& args, int start_cell, int end_cell) {
+    interact_cells_scalar(args, start_cell, end_cell);
+}
+
+void walk_lists_avx2(const ListKernelArgs& args, int start, int end) {
+    walk_lists_scalar(args, start, end);
+}
+
+#endif
+
+CellKernel select_cell_kernel(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX2:
+            return interact_cells_avx2;
+        case KernelIsa::SSE:
+            return interact_cells_sse;
+        default:
+            return interact_cells_scalar;
+    }
+}
+
+ListKernel select_list_kernel(KernelIsa isa) {
+    // without gathers SSE has nothing on the scalar walk
+    return isa == KernelIsa::AVX2 ? walk_lists_avx2 : walk_lists_scalar;
+}
+
+const char* kernel_isa_name(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX2:
+            return "AVX2";
+        case KernelIsa::SSE:
+            return "SSE";
+        default:
+            return "scalar";
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+// Vectorized grid interaction. The grid keeps copies of the blob positions and
+// species in cell order, so the three cells of each neighboring row form one
+// contiguous span, and a blob is interacted with a whole span at a time, 4 or 8
+// neighbors per instruction. Forces come from the precomputed ForceTable. Each
+// blob only accumulates the forces acting on itself, so threads working on
+// different cells never write the same blob.
+//
+// The neighbor-list kernels do the same for Verlet lists (see NeighborList):
+// each blob walks its precomputed list of candidate neighbors instead of the
+// 3x3 cell neighborhood.
+//
+// One implementation per instruction set lives in its own translation unit,
+// compiled with that ISA enabled; select_cell_kernel() picks one at startup
+// from what the CPU supports. The arguments are plain pointers so those
+// translation units don't instantiate any inline code shared with the rest of
+// the program (which would leak e.g. AVX2 instructions into generic code).
+
+// force profiles from ForceTable: force / distance of species b on species a at
+// squared distance d2 is force_table[((a * num_species + b) << table_bits) + bin], with
+// bin = (float_bits(clamp(d2, table_min_d2, table_max_d2)) - table_offset) >> table_shift
+struct ForceLookup {
+    const float* force_table;
+    int num_species;
+    int table_bits;
+    int table_shift;
+    int32_t table_offset;
+    float table_min_d2;
+    float table_max_d2;
+    float max_dist;
+};
+
+struct CellKernelArgs {
+    // grid in CSR form (see SpatialGrid), with positions and species copied
+    // into cell order; the copies are padded so a full vector can be loaded
+    // past the end of the last span
+    const int* cell_start;
+    const int* cell_items;  // cell order -> blob slot
+    const float* x;
+    const float* y;
+    const uint8_t* species;
+    int grid_width;
+    int grid_height;
+
+    ForceLookup forces;
+
+    float* vx;  // indexed by blob slot
+    float* vy;
+};
+
+// interact the blobs of cells [start_cell, end_cell) with their 3x3 neighborhoods
+typedef void (*CellKernel)(const CellKernelArgs& args, int start_cell, int end_cell);
+
+void interact_cells_scalar(const CellKernelArgs& args, int start_cell, int end_cell);
+void interact_cells_sse(const CellKernelArgs& args, int start_cell, int end_cell);
+void interact_cells_avx2(const CellKernelArgs& args, int start_cell, int end_cell);
+
+struct ListKernelArgs {
+    // lists in CSR form: the blob at list position k is slot list_blob[k], its
+    // neighbors are neighbors[list_start[k]] .. neighbors[list_start[k + 1] - 1]
+    // (blob slots), with their species alongside; both padded like the grid copies
+    const int* list_start;
+    const int* list_blob;
+    const int* neighbors;
+    const uint8_t* neighbor_species;
+
+    // current blob state, indexed by slot
+    const float* x;
+    const float* y;
+    const uint8_t* species;
+
+    ForceLookup forces;
+
+    float* vx;
+    float* vy;
+};
+
+// interact the blobs at list positions [start, end) with their listed neighbors
+typedef void (*ListKernel)(const ListKernelArgs& args, int start, int end);
+
+void walk_lists_scalar(const ListKernelArgs& args, int start, int end);
+void walk_lists_avx2(const ListKernelArgs& args, int start, int end);
+
+// elements of padding the kernels may read past the end of the cell-ordered
+// arrays and the neighbor lists
+const int CELL_KERNEL_PADDING = 8;
+
+enum class KernelIsa {
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+// best instruction set this CPU supports
+KernelIsa detect_kernel_isa();
+CellKernel select_cell_kernel(KernelIsa isa);
+ListKernel select_list_kernel(KernelIsa isa);
+const char* kernel_isa_name(KernelIsa isa);
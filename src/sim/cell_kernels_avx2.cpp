@@ -0,0 +1,106 @@
+#include "cell_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+static inline float horizontal_sum(__m256 v) {
+    __m128 sums = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+    sums = _mm_add_ss(sums, _mm_shuffle_ps(sums, sums, 1));
+    return _mm_cvtss_f32(sums);
+}
+
+void interact_cells_avx2(const CellKernelArgs& args, int start_cell, int end_cell) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_dist_sq = _mm256_set1_ps(args.forces.max_dist * args.forces.max_dist);
+    const __m256 table_min_d2 = _mm256_set1_ps(args.forces.table_min_d2);
+    const __m256 table_max_d2 = _mm256_set1_ps(args.forces.table_max_d2);
+    const __m256i table_offset = _mm256_set1_epi32(args.forces.table_offset);
+    const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int cell = start_cell; cell < end_cell; ++cell) {
+        int cell_x = cell % args.grid_width;
+        int cell_y = cell / args.grid_width;
+        int first_x = cell_x > 0 ? cell_x - 1 : cell_x;
+        int last_x = cell_x < args.grid_width - 1 ? cell_x + 1 : cell_x;
+        int first_y = cell_y > 0 ? cell_y - 1 : cell_y;
+        int last_y = cell_y < args.grid_height - 1 ? cell_y + 1 : cell_y;
+
+        for (int i = args.cell_start[cell]; i < args.cell_start[cell + 1]; ++i) {
+            const __m256 this_x = _mm256_set1_ps(args.x[i]);
+            const __m256 this_y = _mm256_set1_ps(args.y[i]);
+            const float* profiles = args.forces.force_table + ((args.species[i] * args.forces.num_species) << args.forces.table_bits);
+            __m256 force_x = zero;
+            __m256 force_y = zero;
+            for (int row = first_y; row <= last_y; ++row) {
+                int begin = args.cell_start[row * args.grid_width + first_x];
+                int end = args.cell_start[row * args.grid_width + last_x + 1];
+                for (int j = begin; j < end; j += 8) {
+                    __m256 dist_x = _mm256_sub_ps(_mm256_loadu_ps(args.x + j), this_x);
+                    __m256 dist_y = _mm256_sub_ps(_mm256_loadu_ps(args.y + j), this_y);
+                    __m256 length_sq = _mm256_add_ps(_mm256_mul_ps(dist_x, dist_x), _mm256_mul_ps(dist_y, dist_y));
+                    __m256 in_span = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(end - j), lane_ids));
+                    __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(length_sq, max_dist_sq, _CMP_LT_OQ),
+                                                    _mm256_cmp_ps(length_sq, zero, _CMP_GT_OQ));
+                    __m256 valid = _mm256_and_ps(in_span, in_range);
+                    if (_mm256_movemask_ps(valid) == 0) {
+                        continue;
+                    }
+                    // bin from the float bits of the squared distance, clamped first so garbage lanes stay in the table
+                    __m256 d2 = _mm256_min_ps(_mm256_max_ps(length_sq, table_min_d2), table_max_d2);
+                    __m256i bin = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_castps_si256(d2), table_offset), args.forces.table_shift);
+                    __m256i species = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(args.species + j)));
+                    __m256i index = _mm256_add_epi32(_mm256_slli_epi32(species, args.forces.table_bits), bin);
+                    // force already divided by length, zero in masked-off lanes
+                    __m256 force = _mm256_mask_i32gather_ps(zero, profiles, index, valid, 4);
+                    force_x = _mm256_add_ps(force_x, _mm256_mul_ps(dist_x, force));
+                    force_y = _mm256_add_ps(force_y, _mm256_mul_ps(dist_y, force));
+                }
+            }
+            int slot = args.cell_items[i];
+            args.vx[slot] += horizontal_sum(force_x);
+            args.vy[slot] += horizontal_sum(force_y);
+        }
+    }
+}
+
+void walk_lists_avx2(const ListKernelArgs& args, int start, int end) {
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_dist_sq = _mm256_set1_ps(args.forces.max_dist * args.forces.max_dist);
+    const __m256 table_min_d2 = _mm256_set1_ps(args.forces.table_min_d2);
+    const __m256 table_max_d2 = _mm256_set1_ps(args.forces.table_max_d2);
+    const __m256i table_offset = _mm256_set1_epi32(args.forces.table_offset);
+    const __m256i lane_ids = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int k = start; k < end; ++k) {
+        int slot = args.list_blob[k];
+        const __m256 this_x = _mm256_set1_ps(args.x[slot]);
+        const __m256 this_y = _mm256_set1_ps(args.y[slot]);
+        const float* profiles = args.forces.force_table + ((args.species[slot] * args.forces.num_species) << args.forces.table_bits);
+        __m256 force_x = zero;
+        __m256 force_y = zero;
+        int list_end = args.list_start[k + 1];
+        for (int n = args.list_start[k]; n < list_end; n += 8) {
+            __m256 in_list = _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(list_end - n), lane_ids));
+            __m256i others = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(args.neighbors + n));
+            __m256 dist_x = _mm256_sub_ps(_mm256_mask_i32gather_ps(zero, args.x, others, in_list, 4), this_x);
+            __m256 dist_y = _mm256_sub_ps(_mm256_mask_i32gather_ps(zero, args.y, others, in_list, 4), this_y);
+            __m256 length_sq = _mm256_add_ps(_mm256_mul_ps(dist_x, dist_x), _mm256_mul_ps(dist_y, dist_y));
+            __m256 in_range = _mm256_and_ps(_mm256_cmp_ps(length_sq, max_dist_sq, _CMP_LT_OQ),
+                                            _mm256_cmp_ps(length_sq, zero, _CMP_GT_OQ));
+            __m256 valid = _mm256_and_ps(in_list, in_range);
+            __m256 d2 = _mm256_min_ps(_mm256_max_ps(length_sq, table_min_d2), table_max_d2);
+            __m256i bin = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_castps_si256(d2), table_offset), args.forces.table_shift);
+            __m256i species = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(args.neighbor_species + n)));
+            __m256i index = _mm256_add_epi32(_mm256_slli_epi32(species, args.forces.table_bits), bin);
+            __m256 force = _mm256_mask_i32gather_ps(zero, profiles, index, valid, 4);
+            force_x = _mm256_add_ps(force_x, _mm256_mul_ps(dist_x, force));
+            force_y = _mm256_add_ps(force_y, _mm256_mul_ps(dist_y, force));
+        }
+        args.vx[slot] += horizontal_sum(force_x);
+        args.vy[slot] += horizontal_sum(force_y);
+    }
+}
+
+#endif
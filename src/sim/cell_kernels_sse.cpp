@@ -0,0 +1,73 @@
+#include "cell_kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <emmintrin.h>
+
+static inline float horizontal_sum(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    return _mm_cvtss_f32(sums);
+}
+
+void interact_cells_sse(const CellKernelArgs& args, int start_cell, int end_cell) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_dist_sq = _mm_set1_ps(args.forces.max_dist * args.forces.max_dist);
+    const __m128 table_min_d2 = _mm_set1_ps(args.forces.table_min_d2);
+    const __m128 table_max_d2 = _mm_set1_ps(args.forces.table_max_d2);
+    const __m128i table_offset = _mm_set1_epi32(args.forces.table_offset);
+    const __m128i lane_ids = _mm_setr_epi32(0, 1, 2, 3);
+
+    for (int cell = start_cell; cell < end_cell; ++cell) {
+        int cell_x = cell % args.grid_width;
+        int cell_y = cell / args.grid_width;
+        int first_x = cell_x > 0 ? cell_x - 1 : cell_x;
+        int last_x = cell_x < args.grid_width - 1 ? cell_x + 1 : cell_x;
+        int first_y = cell_y > 0 ? cell_y - 1 : cell_y;
+        int last_y = cell_y < args.grid_height - 1 ? cell_y + 1 : cell_y;
+
+        for (int i = args.cell_start[cell]; i < args.cell_start[cell + 1]; ++i) {
+            const __m128 this_x = _mm_set1_ps(args.x[i]);
+            const __m128 this_y = _mm_set1_ps(args.y[i]);
+            const float* profiles = args.forces.force_table + ((args.species[i] * args.forces.num_species) << args.forces.table_bits);
+            __m128 force_x = zero;
+            __m128 force_y = zero;
+            for (int row = first_y; row <= last_y; ++row) {
+                int begin = args.cell_start[row * args.grid_width + first_x];
+                int end = args.cell_start[row * args.grid_width + last_x + 1];
+                for (int j = begin; j < end; j += 4) {
+                    __m128 dist_x = _mm_sub_ps(_mm_loadu_ps(args.x + j), this_x);
+                    __m128 dist_y = _mm_sub_ps(_mm_loadu_ps(args.y + j), this_y);
+                    __m128 length_sq = _mm_add_ps(_mm_mul_ps(dist_x, dist_x), _mm_mul_ps(dist_y, dist_y));
+                    __m128 in_span = _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(end - j), lane_ids));
+                    __m128 in_range = _mm_and_ps(_mm_cmplt_ps(length_sq, max_dist_sq), _mm_cmpgt_ps(length_sq, zero));
+                    __m128 valid = _mm_and_ps(in_span, in_range);
+                    if (_mm_movemask_ps(valid) == 0) {
+                        continue;
+                    }
+                    // bin from the float bits of the squared distance, clamped first so garbage lanes stay in the table
+                    __m128 d2 = _mm_min_ps(_mm_max_ps(length_sq, table_min_d2), table_max_d2);
+                    alignas(16) int bin[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(bin),
+                                    _mm_srli_epi32(_mm_sub_epi32(_mm_castps_si128(d2), table_offset), args.forces.table_shift));
+                    // no gather in SSE, species past the span end are padding or other cells' blobs
+                    const uint8_t* species = args.species + j;
+                    __m128 force = _mm_setr_ps(profiles[(species[0] << args.forces.table_bits) + bin[0]],
+                                               profiles[(species[1] << args.forces.table_bits) + bin[1]],
+                                               profiles[(species[2] << args.forces.table_bits) + bin[2]],
+                                               profiles[(species[3] << args.forces.table_bits) + bin[3]]);
+                    force = _mm_and_ps(valid, force);  // already divided by length
+                    force_x = _mm_add_ps(force_x, _mm_mul_ps(dist_x, force));
+                    force_y = _mm_add_ps(force_y, _mm_mul_ps(dist_y, force));
+                }
+            }
+            int slot = args.cell_items[i];
+            args.vx[slot] += horizontal_sum(force_x);
+            args.vy[slot] += horizontal_sum(force_y);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include "cell_partition.hpp"
+
+#include <algorithm>
+
+void CellPartition::resize(int num_threads, int num_cells) {
+    this->num_threads = num_threads;
+    this->num_cells = num_cells;
+    running_cost.resize(num_cells);
+    range_cost.resize(num_threads);
+}
+
+void CellPartition::estimate(const SpatialGrid& grid, int thread, int start_cell, int end_cell) {
+    const int* cell_start = grid.cell_starts();
+    int grid_width = grid.width();
+    int grid_height = grid.height();
+    int64_t sum = 0;
+    for (int cell = start_cell; cell < end_cell; ++cell) {
+        int count = cell_start[cell + 1] - cell_start[cell];
+        if (count > 0) {
+            int cell_x = cell % grid_width;
+            int cell_y = cell / grid_width;
+            // rows of the 3x3 neighborhood are contiguous, so each row is one difference of cell_start
+            int first_x = std::max(cell_x - 1, 0);
+            int last_x = std::min(cell_x + 1, grid_width - 1);
+            int neighborhood = 0;
+            for (int y = std::max(cell_y - 1, 0); y <= std::min(cell_y + 1, grid_height - 1); ++y) {
+                neighborhood += cell_start[y * grid_width + last_x + 1] - cell_start[y * grid_width + first_x];
+            }
+            sum += static_cast<int64_t>(count) * neighborhood;
+        }
+        running_cost[cell] = sum;
+    }
+    range_cost[thread] = sum;
+}
+
+int CellPartition::split_point(int part) const {
+    if (part <= 0) {
+        return 0;
+    }
+    if (part >= num_threads) {
+        return num_cells;
+    }
+    int64_t total = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        total += range_cost[t];
+    }
+    if (total == 0) {
+        return static_cast<long long>(part) * num_cells / num_threads;
+    }
+    int64_t target = total * part / num_threads;
+    // find the estimate range the target falls into, then the cell within it
+    int64_t before = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        if (before + range_cost[t] >= target || t == num_threads - 1) {
+            int first = static_cast<long long>(t) * num_cells / num_threads;
+            int last = static_cast<long long>(t + 1) * num_cells / num_threads;
+            // first cell whose running total (within the range) reaches the target;
+            // the cell that crosses it goes to the earlier part
+            std::vector<int64_t>::const_iterator split = std::lower_bound(running_cost.begin() + first, running_cost.begin() + last, target - before);
+            return std::min(static_cast<int>(split - running_cost.begin()) + 1, last);
+        }
+        before += range_cost[t];
+    }
+    return num_cells;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "spatial_grid.hpp"
+
+// Splits the grid cells into one contiguous range per thread so that every
+// range holds about the same amount of pair work, instead of the same number
+// of cells. A cell's work is estimated as its blob count times the blob count
+// of its 3x3 neighborhood, straight from the grid's cell_start histogram, so a
+// thread that gets a dense cluster gets fewer cells.
+//
+// Balancing is split over threads like the grid build:
+//   estimate(t, ...)  (all threads, once the grid's prefix sum is done) running
+//                     cost sums over an equal share of the cells
+//   begin(t)/end(t)   (any thread, after a barrier) binary search for the split
+//                     points in those sums
+class CellPartition {
+public:
+    void resize(int num_threads, int num_cells);
+
+    void estimate(const SpatialGrid& grid, int thread, int start_cell, int end_cell);
+
+    // balanced cell range of thread
+    int begin(int thread) const { return split_point(thread); }
+    int end(int thread) const { return split_point(thread + 1); }
+
+private:
+    // first cell of part `part`: the first cell whose running cost reaches part / num_threads of the total
+    int split_point(int part) const;
+
+    int num_threads = 0;
+    int num_cells = 0;
+    std::vector<int64_t> running_cost;  // per cell, inclusive sum from the start of its estimate range
+    std::vector<int64_t> range_cost;    // total of each thread's estimate range
+};
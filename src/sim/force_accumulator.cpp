@@ -0,0 +1,42 @@
+#include "force_accumulator.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+static float* align_to_cache_line(float* storage) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage);
+    address = (address + 63) & ~static_cast<uintptr_t>(63);
+    return reinterpret_cast<float*>(address);
+}
+
+void ForceAccumulator::resize(int num_threads, int num_blobs) {
+    if (num_threads == this->num_threads && num_blobs == this->num_blobs) {
+        return;
+    }
+    this->num_threads = num_threads;
+    this->num_blobs = num_blobs;
+    stride = (num_blobs + CACHE_LINE_FLOATS - 1) / CACHE_LINE_FLOATS * CACHE_LINE_FLOATS;
+    // one extra cache line of slack so the buffers can be aligned
+    storage_x.reset(new float[num_threads * stride + CACHE_LINE_FLOATS]);
+    storage_y.reset(new float[num_threads * stride + CACHE_LINE_FLOATS]);
+    base_x = align_to_cache_line(storage_x.get());
+    base_y = align_to_cache_line(storage_y.get());
+}
+
+void ForceAccumulator::clear(int thread) {
+    std::fill(dvx(thread), dvx(thread) + num_blobs, 0.0f);
+    std::fill(dvy(thread), dvy(thread) + num_blobs, 0.0f);
+}
+
+void ForceAccumulator::reduce(BlobStore& blobs, int start, int end) {
+    for (int t = 0; t < num_threads; ++t) {
+        float* thread_dvx = dvx(t);
+        float* thread_dvy = dvy(t);
+        for (int i = start; i < end; ++i) {
+            blobs.vx[i] += thread_dvx[i];
+            blobs.vy[i] += thread_dvy[i];
+            thread_dvx[i] = 0.0f;
+            thread_dvy[i] = 0.0f;
+        }
+    }
+}
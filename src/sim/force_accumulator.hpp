@@ -0,0 +1,36 @@
+#pragma once
+
+#include <memory>
+
+#include "blob_store.hpp"
+
+// Per-thread velocity delta buffers for kernels that apply forces to blobs
+// owned by other threads (e.g. the symmetric pair kernel, which updates both
+// blobs of a pair). Each thread only writes its own buffer; reduce() then adds
+// every thread's deltas into the blob velocities and clears the buffers.
+//
+// Every thread's buffer starts on its own cache line so neighboring threads
+// never write to the same line. resize() leaves the buffers uninitialized, so
+// that every thread zeroes (and first touches) its own buffer with clear().
+class ForceAccumulator {
+public:
+    void resize(int num_threads, int num_blobs);
+    void clear(int thread);
+
+    float* dvx(int thread) { return base_x + thread * stride; }
+    float* dvy(int thread) { return base_y + thread * stride; }
+
+    // add all threads' deltas for blobs [start, end) into their velocities and zero them
+    void reduce(BlobStore& blobs, int start, int end);
+
+private:
+    static const int CACHE_LINE_FLOATS = 64 / sizeof(float);
+
+    int num_threads = 0;
+    int num_blobs = 0;
+    int stride = 0;  // floats per thread, a whole number of cache lines
+    std::unique_ptr<float[]> storage_x;
+    std::unique_ptr<float[]> storage_y;
+    float* base_x = nullptr;  // storage_x aligned up to a cache line
+    float* base_y = nullptr;
+};
@@ -0,0 +1,56 @@
+#include "force_table.hpp"
+
+#include <cmath>
+#include <cstring>
+
+static int32_t float_bits(float f) {
+    int32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(int32_t bits) {
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+int ForceTable::bin(float d2) const {
+    d2 = d2 < lowest_d2 ? lowest_d2 : (d2 > highest_d2 ? highest_d2 : d2);
+    return (float_bits(d2) - bits_offset) >> SHIFT;
+}
+
+void ForceTable::build(const float* rules, int num_species, float max_dist, float min_dist, float repulsion_force) {
+    // the top octave ends at the power of two just above max_dist^2
+    int top_exponent = static_cast<int>(std::ceil(std::log2(max_dist * max_dist)));
+    lowest_d2 = std::ldexp(1.0f, top_exponent - (BINS >> OCTAVE_BITS));
+    highest_d2 = bits_float(float_bits(std::ldexp(1.0f, top_exponent)) - 1);
+    bits_offset = float_bits(lowest_d2);
+
+    float mid_dist = (min_dist + max_dist) / 2;
+    table.resize(num_species * num_species * BINS);
+
+    for (int pair = 0; pair < num_species * num_species; ++pair) {
+        float peak_force = rules[pair];
+        float* profile = &table[pair * BINS];
+        for (int bin = 0; bin < BINS; ++bin) {
+            // sample the middle of the bin
+            float d2 = bits_float(bits_offset + (bin << SHIFT) + (1 << (SHIFT - 1)));
+            float length = std::sqrt(d2);
+            float force;
+            if (length < min_dist) {
+                force = repulsion_force * (length / min_dist) - repulsion_force;
+            }
+            else if (length < mid_dist) {
+                force = peak_force * (length - min_dist) / (mid_dist - min_dist);
+            }
+            else if (length < max_dist) {
+                force = peak_force * (max_dist - length) / (max_dist - mid_dist);
+            }
+            else {
+                force = 0.0f;
+            }
+            profile[bin] = force / length;
+        }
+    }
+}
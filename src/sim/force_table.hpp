@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Precomputed force profiles, one per (species_i, species_j) pair. The force
+// between two blobs is a fixed piecewise-linear curve of their distance, so it
+// is tabulated against the quantized squared distance and already divided by
+// the distance: the kernel turns a neighbor's offset into a velocity change
+// with one table load and a multiply, without a sqrt or a divide.
+//
+// Squared distances are quantized logarithmically, straight from their float
+// bits: each octave of d2 gets the same number of bins. force / distance goes
+// like 1 / distance at close range, where uniform bins would be far too coarse.
+// Below min_d2() a pair gets force / distance of the lowest bin, i.e. only
+// distance / sqrt(min_d2()) of the repulsion force, so the table spans 32
+// octaves to put that floor (about 0.0005 px at the default max_dist) well
+// below any distance two blobs end up at. Kernels only touch the bins of the
+// distances that occur, so the extra low octaves cost memory but no cache.
+//
+//   bin = (float_bits(clamp(d2, min_d2(), max_d2())) - offset()) >> SHIFT
+//
+// The table only depends on the rules, so it is rebuilt whenever they change.
+class ForceTable {
+public:
+    static const int BITS = 11;
+    static const int BINS = 1 << BITS;  // bins per species pair
+    static const int OCTAVE_BITS = 6;  // 64 bins per octave of d2
+    static const int SHIFT = 23 - OCTAVE_BITS;  // float mantissa bits below the bin
+
+    // rules[a * num_species + b] is the peak force of species b on species a
+    void build(const float* rules, int num_species, float max_dist, float min_dist, float repulsion_force);
+
+    // profile of species b acting on species a is data()[((a * num_species + b) << BITS) + bin]
+    const float* data() const { return table.data(); }
+    int32_t offset() const { return bits_offset; }
+    float min_d2() const { return lowest_d2; }
+    float max_d2() const { return highest_d2; }
+
+    int bin(float d2) const;
+
+private:
+    std::vector<float> table;
+    int32_t bits_offset = 0;
+    float lowest_d2 = 0.0f;
+    float highest_d2 = 0.0f;
+};
@@ -0,0 +1,122 @@
+#include "neighbor_list.hpp"
+
+#include <cstring>
+
+#include "cell_kernels.hpp"
+
+void NeighborList::resize(int num_threads, int num_blobs) {
+    this->num_threads = num_threads;
+    list_start.resize(num_blobs + 1);
+    list_blob.resize(num_blobs);
+    build_x.resize(num_blobs);
+    build_y.resize(num_blobs);
+    thread_neighbors.resize(num_threads);
+    thread_species.resize(num_threads);
+    thread_count.resize(num_threads);
+    thread_first.resize(num_threads);
+    thread_last.resize(num_threads);
+    thread_base.resize(num_threads + 1);
+}
+
+void NeighborList::build(const SpatialGrid& grid, float cutoff, int thread, int start_cell, int end_cell) {
+    std::vector<int>& local_neighbors = thread_neighbors[thread];
+    std::vector<uint8_t>& local_species = thread_species[thread];
+    size_t count = 0;  // the buffers keep their size from the last build, only grow
+
+    const float* sorted_x = grid.sorted_x_data();
+    const float* sorted_y = grid.sorted_y_data();
+    const uint8_t* sorted_species = grid.sorted_species_data();
+    float cutoff_sq = cutoff * cutoff;
+    int grid_width = grid.width();
+    int grid_height = grid.height();
+
+    thread_first[thread] = grid.cell_begin(start_cell);
+    thread_last[thread] = grid.cell_begin(end_cell);
+    for (int cell = start_cell; cell < end_cell; ++cell) {
+        int cell_x = cell % grid_width;
+        int cell_y = cell / grid_width;
+        // the cells left and right of a neighbor row are contiguous in cell order
+        int first_x = cell_x > 0 ? cell_x - 1 : cell_x;
+        int last_x = cell_x < grid_width - 1 ? cell_x + 1 : cell_x;
+        int first_y = cell_y > 0 ? cell_y - 1 : cell_y;
+        int last_y = cell_y < grid_height - 1 ? cell_y + 1 : cell_y;
+
+        // every candidate of this cell's blobs is in these three spans
+        int span_begin[3];
+        int span_end[3];
+        int num_spans = 0;
+        int candidates = 0;
+        for (int row = first_y; row <= last_y; ++row, ++num_spans) {
+            span_begin[num_spans] = grid.cell_begin(row * grid_width + first_x);
+            span_end[num_spans] = grid.cell_end(row * grid_width + last_x);
+            candidates += span_end[num_spans] - span_begin[num_spans];
+        }
+
+        for (int k = grid.cell_begin(cell); k < grid.cell_end(cell); ++k) {
+            // grow once per blob if needed, then append branch-free
+            if (local_neighbors.size() < count + candidates) {
+                local_neighbors.resize(2 * (count + candidates));
+                local_species.resize(2 * (count + candidates));
+            }
+            int* out_neighbors = &local_neighbors[0];
+            uint8_t* out_species = &local_species[0];
+
+            list_start[k] = count;  // relative to this thread's buffer until merge()
+            list_blob[k] = grid.item(k);
+            float this_x = sorted_x[k];
+            float this_y = sorted_y[k];
+            for (int span = 0; span < num_spans; ++span) {
+                for (int j = span_begin[span]; j < span_end[span]; ++j) {
+                    float dist_x = sorted_x[j] - this_x;
+                    float dist_y = sorted_y[j] - this_y;
+                    out_neighbors[count] = grid.item(j);
+                    out_species[count] = sorted_species[j];
+                    count += (j != k) & (dist_x * dist_x + dist_y * dist_y < cutoff_sq);
+                }
+            }
+        }
+    }
+    thread_count[thread] = count;
+}
+
+void NeighborList::prefix_sum() {
+    int total = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        thread_base[t] = total;
+        total += thread_count[t];
+    }
+    thread_base[num_threads] = total;
+    num_listed = 0;
+    for (int t = 0; t < num_threads; ++t) {
+        num_listed = thread_last[t] > num_listed ? thread_last[t] : num_listed;
+    }
+    list_start[num_listed] = total;
+    neighbors.resize(total + CELL_KERNEL_PADDING);
+    neighbor_species.resize(total + CELL_KERNEL_PADDING);
+}
+
+void NeighborList::merge(const BlobStore& blobs, int thread) {
+    int base = thread_base[thread];
+    int count = thread_count[thread];
+    if (count > 0) {
+        std::memcpy(&neighbors[base], thread_neighbors[thread].data(), count * sizeof(int));
+        std::memcpy(&neighbor_species[base], thread_species[thread].data(), count);
+    }
+    for (int k = thread_first[thread]; k < thread_last[thread]; ++k) {
+        list_start[k] += base;
+        int slot = list_blob[k];
+        build_x[slot] = blobs.x[slot];
+        build_y[slot] = blobs.y[slot];
+    }
+}
+
+float NeighborList::max_displacement_sq(const BlobStore& blobs, int start, int end) const {
+    float max_sq = 0.0f;
+    for (int i = start; i < end; ++i) {
+        float dist_x = blobs.x[i] - build_x[i];
+        float dist_y = blobs.y[i] - build_y[i];
+        float dist_sq = dist_x * dist_x + dist_y * dist_y;
+        max_sq = dist_sq > max_sq ? dist_sq : max_sq;
+    }
+    return max_sq;
+}
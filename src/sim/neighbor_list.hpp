@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "blob_store.hpp"
+#include "spatial_grid.hpp"
+
+// Verlet neighbor lists. Blobs only move a fraction of MAX_DIST per step, so
+// instead of scanning the 3x3 cell neighborhood every step, each blob keeps a
+// list of every blob within MAX_DIST + skin, built from a grid whose cells are
+// that large. The lists stay valid until some blob has moved more than skin / 2
+// since they were built (two blobs approaching each other then closed at most
+// one skin), so they only need rebuilding every few steps.
+//
+// The lists are one CSR array over all blobs, in the grid's cell order. A build
+// is split over threads like the grid:
+//   build(t, ...)   each thread collects the lists of its cells into its own buffer
+//   prefix_sum()    (one thread) lays the thread buffers out back to back
+//   merge(t)        each thread copies its buffer into the shared arrays
+//
+// Lists refer to blob slots, so they go stale when the blob store is reordered.
+class NeighborList {
+public:
+    void resize(int num_threads, int num_blobs);
+
+    void build(const SpatialGrid& grid, float cutoff, int thread, int start_cell, int end_cell);
+    void prefix_sum();
+    void merge(const BlobStore& blobs, int thread);
+
+    // largest squared distance any of blobs [start, end) moved since the lists were built
+    float max_displacement_sq(const BlobStore& blobs, int start, int end) const;
+
+    // number of blobs with a list (blobs outside the grid have none)
+    int size() const { return num_listed; }
+
+    const int* list_starts() const { return list_start.data(); }
+    const int* list_blobs() const { return list_blob.data(); }
+    const int* neighbor_slots() const { return neighbors.data(); }
+    const uint8_t* neighbor_species_data() const { return neighbor_species.data(); }
+
+private:
+    int num_threads = 0;
+    int num_listed = 0;
+
+    std::vector<int> list_start;  // list position -> first neighbor, num_listed + 1
+    std::vector<int> list_blob;   // list position -> blob slot
+    std::vector<int> neighbors;   // blob slots, padded
+    std::vector<uint8_t> neighbor_species;
+    std::vector<float> build_x;   // positions at build time, by slot
+    std::vector<float> build_y;
+
+    // per-thread build buffers
+    std::vector<std::vector<int> > thread_neighbors;
+    std::vector<std::vector<uint8_t> > thread_species;
+    std::vector<int> thread_count;  // neighbors each thread collected
+    std::vector<int> thread_first;  // first list position built by each thread
+    std::vector<int> thread_last;
+    std::vector<int> thread_base;   // where each thread's neighbors go in the shared arrays
+};
@@ -0,0 +1,113 @@
+#include "profiler.hpp"
+
+#include <cmath>
+#include <fstream>
+
+Profiler::Profiler(int num_threads, int events_per_thread)
+    : events_per_thread(events_per_thread), rings(num_threads < 1 ? 1 : num_threads),
+      frame_start(Clock::now()), frame_seconds(HISTORY, 0.0), section_seconds(HISTORY * MAX_SECTIONS, 0.0) {
+    for (Ring& ring : rings) {
+        ring.events.resize(events_per_thread);
+    }
+    drained_events.resize(events_per_thread);
+}
+
+int Profiler::section(const std::string& name) {
+    for (int i = 0; i < num_sections(); ++i) {
+        if (section_names[i] == name) {
+            return i;
+        }
+    }
+    if (num_sections() == MAX_SECTIONS) {
+        return -1;
+    }
+    section_names.push_back(name);
+    return num_sections() - 1;
+}
+
+void Profiler::record(int thread, int section, Clock::time_point begin, Clock::time_point end) {
+    if (section < 0) {
+        return;
+    }
+    Ring& ring = rings[thread];
+    uint64_t written = ring.written.load(std::memory_order_relaxed);
+    Event& event = ring.events[written % events_per_thread];
+    event.section = section;
+    event.begin = begin;
+    event.end = end;
+    ring.written.store(written + 1, std::memory_order_release);
+}
+
+void Profiler::end_frame() {
+    Clock::time_point now = Clock::now();
+    int slot = history_slot(frame_count);
+    frame_seconds[slot] = std::chrono::duration<double>(now - frame_start).count();
+    frame_start = now;
+
+    double* sections = &section_seconds[slot * MAX_SECTIONS];
+    std::fill(sections, sections + MAX_SECTIONS, 0.0);
+    uint64_t ring_size = events_per_thread;
+    for (Ring& ring : rings) {
+        uint64_t written = ring.written.load(std::memory_order_acquire);
+        // anything older than one ring's worth has been overwritten
+        uint64_t first = std::max<uint64_t>(ring.drained, written > ring_size ? written - ring_size : 0);
+        for (uint64_t i = first; i < written; ++i) {
+            drained_events[i - first] = ring.events[i % ring_size];
+        }
+        // the owner is writing event now_written into the slot of now_written - ring_size,
+        // so that one and every older event may have been torn during the copy
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t now_written = ring.written.load(std::memory_order_relaxed);
+        uint64_t intact = std::max(first, now_written >= ring_size ? now_written - ring_size + 1 : 0);
+        for (uint64_t i = intact; i < written; ++i) {
+            const Event& event = drained_events[i - first];
+            sections[event.section] += std::chrono::duration<double>(event.end - event.begin).count();
+        }
+        ring.drained = written;
+    }
+    ++frame_count;
+}
+
+double Profiler::percentile(std::vector<double> samples, double p) const {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    // nearest rank
+    std::sort(samples.begin(), samples.end());
+    int rank = static_cast<int>(std::ceil(p / 100.0 * samples.size()));
+    return samples[std::min(std::max(rank, 1), static_cast<int>(samples.size())) - 1];
+}
+
+double Profiler::section_percentile(int section, double p) const {
+    std::vector<double> samples(frames_recorded());
+    for (int i = 0; i < frames_recorded(); ++i) {
+        samples[i] = section_seconds[i * MAX_SECTIONS + section];
+    }
+    return percentile(samples, p);
+}
+
+double Profiler::frame_percentile(double p) const {
+    return percentile(std::vector<double>(frame_seconds.begin(), frame_seconds.begin() + frames_recorded()), p);
+}
+
+bool Profiler::write_csv(const std::string& path) const {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        return false;
+    }
+    out << "frame,frame_ms";
+    for (const std::string& name : section_names) {
+        out << "," << name << "_ms";
+    }
+    out << "\n";
+    // oldest frame first
+    for (long long frame = frame_count - frames_recorded(); frame < frame_count; ++frame) {
+        int slot = history_slot(frame);
+        out << frame << "," << frame_seconds[slot] * 1e3;
+        for (int section = 0; section < num_sections(); ++section) {
+            out << "," << section_seconds[slot * MAX_SECTIONS + section] * 1e3;
+        }
+        out << "\n";
+    }
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Frame profiler. Code marks named sections with record() or a ScopedTimer;
+// every thread writes into its own fixed-size ring of events, so recording
+// takes no lock and does no allocation. Once per frame, end_frame() (on one
+// thread) drains all rings, adds up each section's time for the frame and
+// keeps the last HISTORY frames for percentiles and CSV export.
+//
+// Each ring has a single writer (its thread) and a single reader (end_frame),
+// synchronized by a release store of the write position. A thread that records
+// more than events_per_thread events between two end_frame() calls loses the
+// oldest ones. The writer never waits, so it may lap the ring while end_frame()
+// reads it (the simulation thread records every stage of a turbo batch):
+// end_frame() copies the events out first, then re-reads the write position and
+// drops every copied event whose slot may have been rewritten meanwhile.
+class Profiler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static const int HISTORY = 600;  // frames kept
+    static const int MAX_SECTIONS = 32;
+
+    explicit Profiler(int num_threads, int events_per_thread = 1024);
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // id of the section called name, registered on first use, or -1 once
+    // MAX_SECTIONS are taken (spans of section -1 are dropped); not thread
+    // safe, register every section before recording starts
+    int section(const std::string& name);
+    int num_sections() const { return section_names.size(); }
+    const std::string& section_name(int section) const { return section_names[section]; }
+
+    // add one timed span of section on thread
+    void record(int thread, int section, Clock::time_point begin, Clock::time_point end);
+
+    // close the current frame; the frame time is the time since the previous call
+    void end_frame();
+
+    int frames_recorded() const { return std::min<long long>(frame_count, HISTORY); }
+
+    // percentile p (0-100) over the recorded frames, in seconds
+    double section_percentile(int section, double p) const;
+    double frame_percentile(double p) const;
+
+    // one row per recorded frame: frame number, frame time, then every section in ms
+    bool write_csv(const std::string& path) const;
+
+private:
+    struct Event {
+        int section;
+        Clock::time_point begin;
+        Clock::time_point end;
+    };
+
+    struct Ring {
+        std::vector<Event> events;
+        std::atomic<uint64_t> written{0};  // total events ever pushed, only the owner thread writes it
+        uint64_t drained = 0;               // events end_frame() has consumed
+    };
+
+    double percentile(std::vector<double> samples, double p) const;
+    int history_slot(long long frame) const { return frame % HISTORY; }
+
+    int events_per_thread;
+    std::vector<Ring> rings;
+    std::vector<Event> drained_events;  // end_frame()'s copy of one ring
+    std::vector<std::string> section_names;
+
+    long long frame_count = 0;
+    Clock::time_point frame_start;
+    std::vector<double> frame_seconds;    // HISTORY frames
+    std::vector<double> section_seconds;  // HISTORY frames x MAX_SECTIONS, section time per frame
+};
+
+// Records the lifetime of the timer as one span of a section.
+class ScopedTimer {
+public:
+    ScopedTimer(Profiler* profiler, int thread, int section)
+        : profiler(profiler), thread(thread), section(section), begin(Profiler::Clock::now()) {}
+
+    ~ScopedTimer() {
+        if (profiler) {
+            profiler->record(thread, section, begin, Profiler::Clock::now());
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Profiler* profiler;
+    int thread;
+    int section;
+    Profiler::Clock::time_point begin;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+
+// Counter-based random numbers (Philox4x32-10, Salmon et al. 2011): the n-th
+// block of a stream is a pure function of (seed, stream, n), so every blob,
+// thread or operation can draw from its own stream without any shared state,
+// in any order, with the same results on every platform.
+//
+// A stream id is 64 bits, use random_stream() to build one from a purpose, an
+// index (a blob slot, a thread...) and a generation (the n-th time the rules
+// or blobs were randomized...).
+class RandomStream {
+public:
+    RandomStream(uint64_t seed, uint64_t stream) {
+        key[0] = static_cast<uint32_t>(seed);
+        key[1] = static_cast<uint32_t>(seed >> 32);
+        counter[0] = 0;
+        counter[1] = 0;
+        counter[2] = static_cast<uint32_t>(stream);
+        counter[3] = static_cast<uint32_t>(stream >> 32);
+    }
+
+    uint32_t next_u32() {
+        if (used == 4) {
+            philox(counter, key, block);
+            if (++counter[0] == 0) {
+                ++counter[1];
+            }
+            used = 0;
+        }
+        return block[used++];
+    }
+
+    // uniform in [0, 1), 24 random bits
+    float next_float() {
+        return (next_u32() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // uniform in [min, max)
+    float uniform(float min, float max) {
+        return min + (max - min) * next_float();
+    }
+
+    // uniform in [min, max], both ends included, without modulo bias (Lemire's method)
+    int uniform_int(int min, int max) {
+        uint32_t range = static_cast<uint32_t>(max) - static_cast<uint32_t>(min) + 1;
+        if (range == 0) {  // the full 32-bit range
+            return static_cast<int>(next_u32());
+        }
+        uint64_t product = static_cast<uint64_t>(next_u32()) * range;
+        if (static_cast<uint32_t>(product) < range) {
+            uint32_t threshold = -range % range;
+            while (static_cast<uint32_t>(product) < threshold) {
+                product = static_cast<uint64_t>(next_u32()) * range;
+            }
+        }
+        return min + static_cast<int>(product >> 32);
+    }
+
+private:
+    static void philox(const uint32_t in[4], const uint32_t in_key[2], uint32_t out[4]) {
+        uint32_t c0 = in[0], c1 = in[1], c2 = in[2], c3 = in[3];
+        uint32_t k0 = in_key[0], k1 = in_key[1];
+        for (int round = 0; round < 10; ++round) {
+            uint64_t product0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+            uint64_t product1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+            uint32_t hi0 = static_cast<uint32_t>(product0 >> 32), lo0 = static_cast<uint32_t>(product0);
+            uint32_t hi1 = static_cast<uint32_t>(product1 >> 32), lo1 = static_cast<uint32_t>(product1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        out[0] = c0;
+        out[1] = c1;
+        out[2] = c2;
+        out[3] = c3;
+    }
+
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int used = 4;
+};
+
+// what a stream is used for, so streams of different purposes never overlap
+enum class RandomPurpose : uint8_t {
+    Rules,
+    Blobs,
+    Colors,
+    Mutation,
+};
+
+// purpose in the top 8 bits, then 24 bits of generation and 32 bits of index
+inline uint64_t random_stream(RandomPurpose purpose, uint32_t index, uint32_t generation = 0) {
+    return static_cast<uint64_t>(purpose) << 56 | static_cast<uint64_t>(generation & 0xFFFFFF) << 32 | index;
+}
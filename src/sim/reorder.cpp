@@ -0,0 +1,66 @@
+#include "reorder.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+// spread the low 16 bits of v out to the even bits
+static uint32_t part_1_by_1(uint32_t v) {
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+static uint32_t morton_key(int cell_x, int cell_y) {
+    return part_1_by_1(cell_x) | (part_1_by_1(cell_y) << 1);
+}
+
+void BlobReorder::plan(const SpatialGrid& grid, int num_blobs, BlobOrder order) {
+    if (order == BlobOrder::Morton && (morton_width != grid.width() || morton_height != grid.height())) {
+        morton_width = grid.width();
+        morton_height = grid.height();
+        morton_cells.resize(grid.num_cells());
+        for (int c = 0; c < grid.num_cells(); ++c) {
+            morton_cells[c] = c;
+        }
+        int grid_width = grid.width();
+        std::sort(morton_cells.begin(), morton_cells.end(), [grid_width](int a, int b) {
+            return morton_key(a % grid_width, a / grid_width) < morton_key(b % grid_width, b / grid_width);
+        });
+    }
+
+    new_order.resize(num_blobs);
+    int slot = 0;
+    for (int c = 0; c < grid.num_cells(); ++c) {
+        int cell = order == BlobOrder::Morton ? morton_cells[c] : c;
+        for (int k = grid.cell_begin(cell); k < grid.cell_end(cell); ++k) {
+            new_order[slot++] = grid.item(k);
+        }
+    }
+    // blobs that were out of bounds are not in the grid, keep them at the end
+    for (int i = 0; i < num_blobs; ++i) {
+        if (grid.cell_of_blob(i) < 0) {
+            new_order[slot++] = i;
+        }
+    }
+    scratch.resize(num_blobs);
+}
+
+void BlobReorder::gather(const BlobStore& blobs, int start, int end) {
+    for (int k = start; k < end; ++k) {
+        int old_slot = new_order[k];
+        scratch.x[k] = blobs.x[old_slot];
+        scratch.y[k] = blobs.y[old_slot];
+        scratch.vx[k] = blobs.vx[old_slot];
+        scratch.vy[k] = blobs.vy[old_slot];
+        scratch.species[k] = blobs.species[old_slot];
+        scratch.id[k] = blobs.id[old_slot];
+        scratch.slot_of_id[blobs.id[old_slot]] = k;
+    }
+}
+
+void BlobReorder::commit(BlobStore& blobs) {
+    blobs.swap(scratch);
+}
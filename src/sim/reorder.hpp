@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+#include "blob_store.hpp"
+#include "spatial_grid.hpp"
+
+enum class BlobOrder {
+    None,    // keep creation order
+    Cell,    // row-major grid cell order
+    Morton,  // Z-order over grid cells, keeps 2D neighborhoods closer together
+};
+
+// Periodically permutes the blob storage into spatial order, so the blobs of a
+// grid cell and of its neighbors sit next to each other in memory and the
+// neighbor scan reads nearly sequentially instead of all over the arrays.
+//
+// A reorder is split into phases like the grid build:
+//   plan()     (one thread) derive the new slot order from a freshly built grid
+//   gather()   (all threads) copy their range of the new order into scratch
+//   commit()   (one thread) swap the scratch into place
+// The grid still refers to the old slots afterwards and has to be rebuilt
+// before it is used again.
+class BlobReorder {
+public:
+    void plan(const SpatialGrid& grid, int num_blobs, BlobOrder order);
+    void gather(const BlobStore& blobs, int start, int end);
+    void commit(BlobStore& blobs);
+
+private:
+    std::vector<int> new_order;     // new slot -> old slot
+    std::vector<int> morton_cells;  // grid cells sorted by Morton key
+    int morton_width = 0;
+    int morton_height = 0;
+    BlobStore scratch;
+};
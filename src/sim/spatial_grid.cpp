@@ -0,0 +1,69 @@
+#include "spatial_grid.hpp"
+
+#include "cell_kernels.hpp"
+
+void SpatialGrid::resize(int world_width, int world_height, int cell_size, int num_blobs, int num_threads) {
+    this->cell_size = cell_size;
+    this->num_threads = num_threads;
+    grid_width = world_width / cell_size + 1;  // in cells
+    grid_height = world_height / cell_size + 1;  // in cells
+    cell_start.resize(num_cells() + 1);
+    cell_items.resize(num_blobs);
+    blob_cell.resize(num_blobs);
+    thread_counts.resize(num_threads * num_cells());
+    sorted_x.resize(num_blobs + CELL_KERNEL_PADDING);
+    sorted_y.resize(num_blobs + CELL_KERNEL_PADDING);
+    sorted_species.resize(num_blobs + CELL_KERNEL_PADDING);
+}
+
+void SpatialGrid::clear_counts(int thread) {
+    int* counts = &thread_counts[thread * num_cells()];
+    for (int c = 0; c < num_cells(); ++c) {
+        counts[c] = 0;
+    }
+}
+
+void SpatialGrid::count(const BlobStore& blobs, int thread, int start, int end) {
+    int* counts = &thread_counts[thread * num_cells()];
+    for (int i = start; i < end; ++i) {
+        int grid_x = blobs.x[i] / cell_size;
+        int grid_y = blobs.y[i] / cell_size;
+        if (blobs.x[i] < 0.0f || grid_x >= grid_width || blobs.y[i] < 0.0f || grid_y >= grid_height) {
+            // blob out of bounds (e.g. the window just shrank), leave it out of the grid this frame
+            blob_cell[i] = -1;
+            continue;
+        }
+        int cell = grid_y * grid_width + grid_x;
+        blob_cell[i] = cell;
+        ++counts[cell];
+    }
+}
+
+void SpatialGrid::prefix_sum() {
+    int total = 0;
+    for (int c = 0; c < num_cells(); ++c) {
+        cell_start[c] = total;
+        for (int t = 0; t < num_threads; ++t) {
+            int& slot = thread_counts[t * num_cells() + c];
+            int count = slot;
+            slot = total;  // thread t writes its blobs of cell c from here
+            total += count;
+        }
+    }
+    cell_start[num_cells()] = total;
+}
+
+void SpatialGrid::scatter(const BlobStore& blobs, int thread, int start, int end) {
+    int* offsets = &thread_counts[thread * num_cells()];
+    for (int i = start; i < end; ++i) {
+        int cell = blob_cell[i];
+        if (cell < 0) {
+            continue;
+        }
+        int k = offsets[cell]++;
+        cell_items[k] = i;
+        sorted_x[k] = blobs.x[i];
+        sorted_y[k] = blobs.y[i];
+        sorted_species[k] = blobs.species[i];
+    }
+}
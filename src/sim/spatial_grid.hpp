@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "blob_store.hpp"
+
+// Uniform grid over the world stored in compressed (CSR) form: the blobs of
+// cell c are cell_items[cell_start[c]] .. cell_items[cell_start[c + 1] - 1].
+// The arrays are kept across frames and rebuilt with a two-pass counting sort,
+// so a rebuild does no allocation once the grid has reached its working size.
+//
+// A rebuild is split over threads by blob range:
+//   clear_counts(t) + count(t, ...)
+//                   each thread bins its blobs into its own histogram; count()
+//                   adds to it, so a share can be counted in consecutive pieces
+//                   (e.g. right after integrating each of them)
+//   prefix_sum()    turns the histograms into cell_start and write offsets
+//   scatter(t, ...) each thread writes its blobs into cell_items
+// Blobs keep their index order within a cell, whatever the thread count.
+//
+// scatter() also copies positions and species into cell order, for the
+// vectorized kernels that read neighbor cells as contiguous spans.
+class SpatialGrid {
+public:
+    // (re)size the grid for a world of width x height; cheap when nothing changed
+    void resize(int world_width, int world_height, int cell_size, int num_blobs, int num_threads);
+
+    void clear_counts(int thread);
+    void count(const BlobStore& blobs, int thread, int start, int end);
+    void prefix_sum();
+    void scatter(const BlobStore& blobs, int thread, int start, int end);
+
+    int width() const { return grid_width; }
+    int height() const { return grid_height; }
+    int num_cells() const { return grid_width * grid_height; }
+
+    // range of cell_items belonging to cell
+    int cell_begin(int cell) const { return cell_start[cell]; }
+    int cell_end(int cell) const { return cell_start[cell + 1]; }
+    int item(int k) const { return cell_items[k]; }
+    // cell blob i was binned into, -1 if it was out of bounds
+    int cell_of_blob(int i) const { return blob_cell[i]; }
+
+    // raw CSR arrays and the cell-ordered copies, for the cell kernels
+    const int* cell_starts() const { return cell_start.data(); }
+    const int* items() const { return cell_items.data(); }
+    const float* sorted_x_data() const { return sorted_x.data(); }
+    const float* sorted_y_data() const { return sorted_y.data(); }
+    const uint8_t* sorted_species_data() const { return sorted_species.data(); }
+
+private:
+    int cell_size = 1;
+    int grid_width = 0;
+    int grid_height = 0;
+    int num_threads = 0;
+
+    std::vector<int> cell_start;     // num_cells + 1 prefix sums
+    std::vector<int> cell_items;     // blob indices grouped by cell
+    std::vector<int> blob_cell;      // cell of each blob, -1 if out of bounds
+    std::vector<int> thread_counts;  // per-thread histograms, then per-thread write offsets
+    std::vector<float> sorted_x;     // positions and species in cell_items order, padded
+    std::vector<float> sorted_y;
+    std::vector<uint8_t> sorted_species;
+};
@@ -0,0 +1,234 @@
+#include "step_kernels.hpp"
+
+#include <array>
+#include <cmath>
+
+// flat rule matrix sized at compile time
+template <int NumSpecies>
+struct RuleMatrix {
+    std::array<float, NumSpecies * NumSpecies> force;
+
+    RuleMatrix(const float* rules, int num_species) {
+        force.fill(0.0f);
+        for (int a = 0; a < num_species; ++a) {
+            for (int b = 0; b < num_species; ++b) {
+                force[a * NumSpecies + b] = rules[a * num_species + b];
+            }
+        }
+    }
+
+    float operator()(int a, int b) const {
+        return force[a * NumSpecies + b];
+    }
+};
+
+template <int NumSpecies, Boundary BoundaryMode, bool Mouse>
+struct StepKernels {
+    // accumulate the force blob j exerts on blob i into blob i's velocity
+    static void interact_with(BlobStore& blobs, const RuleMatrix<NumSpecies>& rules, const StepParams& params, int i, int j) {
+        // calculate the distance between the two blobs
+        float dist_x = blobs.x[j] - blobs.x[i];
+        float dist_y = blobs.y[j] - blobs.y[i];
+        float length = std::sqrt(dist_x * dist_x + dist_y * dist_y);
+        float peak_force = rules(blobs.species[i], blobs.species[j]);
+        float force;
+        float min_dist = params.min_dist;
+        float max_dist = params.max_dist;
+        // if the distance is less than the max distance, interact
+        if (length == 0) {  // don't divide by zero (interacting with self)
+            return;
+        }
+        else if (length < min_dist) {
+            force = params.repulsion_force * (length / min_dist) - params.repulsion_force;
+        }
+        else if (length < (min_dist + max_dist) / 2) {
+            force = peak_force * (length - min_dist) / ((min_dist + max_dist) / 2 - min_dist);
+        }
+        else if (length < max_dist) {
+            force = peak_force * (max_dist - length) / (max_dist - (min_dist + max_dist) / 2);
+        }
+        else {
+            return;
+        }
+        // apply the force to the velocity
+        blobs.vx[i] += dist_x / length * force;
+        blobs.vy[i] += dist_y / length * force;
+    }
+
+    // interact blobs in a certain grid cells with blobs in adjacent grid cells (start to end grid cell)
+    static void interact_per_blob(BlobStore& blobs, const SpatialGrid& grid, const StepParams& params, int start_cell, int end_cell) {
+        RuleMatrix<NumSpecies> rules(params.rules, params.num_species);
+        int grid_width = grid.width();
+        int grid_height = grid.height();
+
+        for (int this_cell = start_cell; this_cell < end_cell; ++this_cell) {
+            int this_cell_x = this_cell % grid_width;
+            int this_cell_y = this_cell / grid_width;
+            for (int i = grid.cell_begin(this_cell); i < grid.cell_end(this_cell); ++i) {
+                int this_blob = grid.item(i);
+                for (int x = -1; x <= 1; ++x) {
+                    for (int y = -1; y <= 1; ++y) {
+                        int other_cell_x = this_cell_x + x;
+                        int other_cell_y = this_cell_y + y;
+                        if (other_cell_x < 0 || other_cell_x >= grid_width || other_cell_y < 0 || other_cell_y >= grid_height) {
+                            continue;
+                        }
+                        int other_cell = other_cell_y * grid_width + other_cell_x;
+                        for (int j = grid.cell_begin(other_cell); j < grid.cell_end(other_cell); ++j) {
+                            int other_blob = grid.item(j);
+                            if (other_blob == this_blob) {
+                                continue;
+                            }
+                            interact_with(blobs, rules, params, this_blob, other_blob);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // apply the forces of one unordered pair to both blobs: the distance and the
+    // shape of the force curve are shared, only the peak force differs per direction
+    static void interact_pair(const BlobStore& blobs, const RuleMatrix<NumSpecies>& rules, const StepParams& params, int i, int j,
+                              float* dvx, float* dvy) {
+        float dist_x = blobs.x[j] - blobs.x[i];
+        float dist_y = blobs.y[j] - blobs.y[i];
+        float length_sq = dist_x * dist_x + dist_y * dist_y;
+        if (length_sq >= params.max_dist * params.max_dist || length_sq == 0) {  // out of range, or same position
+            return;
+        }
+        float length = std::sqrt(length_sq);
+        float min_dist = params.min_dist;
+        float mid_dist = (min_dist + params.max_dist) / 2;
+        float force_ij;  // force on i towards j
+        float force_ji;  // force on j towards i
+        if (length < min_dist) {
+            force_ij = params.repulsion_force * (length / min_dist) - params.repulsion_force;
+            force_ji = force_ij;
+        }
+        else {
+            float shape = length < mid_dist ? (length - min_dist) / (mid_dist - min_dist)
+                                            : (params.max_dist - length) / (params.max_dist - mid_dist);
+            force_ij = rules(blobs.species[i], blobs.species[j]) * shape;
+            force_ji = rules(blobs.species[j], blobs.species[i]) * shape;
+        }
+        float dir_x = dist_x / length;
+        float dir_y = dist_y / length;
+        dvx[i] += dir_x * force_ij;
+        dvy[i] += dir_y * force_ij;
+        dvx[j] -= dir_x * force_ji;
+        dvy[j] -= dir_y * force_ji;
+    }
+
+    // same interactions as interact_per_blob, but each unordered pair is visited once:
+    // pairs inside a cell, plus the half of the 3x3 neighborhood that comes after the cell.
+    // Both blobs of a pair get their force, so the deltas go into this thread's buffers
+    // and have to be reduced into the velocities afterwards.
+    static void interact_symmetric(const BlobStore& blobs, const SpatialGrid& grid, const StepParams& params, int start_cell, int end_cell,
+                                   float* dvx, float* dvy) {
+        static const int forward_cells[4][2] = {{1, 0}, {-1, 1}, {0, 1}, {1, 1}};
+        RuleMatrix<NumSpecies> rules(params.rules, params.num_species);
+        int grid_width = grid.width();
+        int grid_height = grid.height();
+
+        for (int this_cell = start_cell; this_cell < end_cell; ++this_cell) {
+            int this_cell_x = this_cell % grid_width;
+            int this_cell_y = this_cell / grid_width;
+            int this_end = grid.cell_end(this_cell);
+            for (int i = grid.cell_begin(this_cell); i < this_end; ++i) {
+                int this_blob = grid.item(i);
+                for (int j = i + 1; j < this_end; ++j) {
+                    interact_pair(blobs, rules, params, this_blob, grid.item(j), dvx, dvy);
+                }
+                for (int n = 0; n < 4; ++n) {
+                    int other_cell_x = this_cell_x + forward_cells[n][0];
+                    int other_cell_y = this_cell_y + forward_cells[n][1];
+                    if (other_cell_x < 0 || other_cell_x >= grid_width || other_cell_y >= grid_height) {
+                        continue;
+                    }
+                    int other_cell = other_cell_y * grid_width + other_cell_x;
+                    for (int j = grid.cell_begin(other_cell); j < grid.cell_end(other_cell); ++j) {
+                        interact_pair(blobs, rules, params, this_blob, grid.item(j), dvx, dvy);
+                    }
+                }
+            }
+        }
+    }
+
+    static void integrate(BlobStore& blobs, const StepParams& params, int start, int end) {
+        for (int i = start; i < end; ++i) {
+            if (Mouse) {
+                // calculate the distance between the blob and the mouse
+                float dist_x = params.mouse_x - blobs.x[i];
+                float dist_y = params.mouse_y - blobs.y[i];
+                float length = std::sqrt(dist_x * dist_x + dist_y * dist_y);
+                if (length != 0 && length < params.max_dist) {
+                    blobs.vx[i] += dist_x / length * params.mouse_force;
+                    blobs.vy[i] += dist_y / length * params.mouse_force;
+                }
+            }
+
+            // Update the blob's position based on its velocity
+            blobs.x[i] += blobs.vx[i];
+            blobs.y[i] += blobs.vy[i];
+
+            // Apply friction to the velocity
+            blobs.vx[i] *= params.friction;
+            blobs.vy[i] *= params.friction;
+
+            // bounce off (or stop at) the walls
+            float wall_factor = BoundaryMode == Boundary::Bounce ? -1.0f : 0.0f;
+            if (blobs.x[i] < 0.0f) {
+                blobs.x[i] = 0.0f;
+                blobs.vx[i] *= wall_factor;
+            }
+            if (blobs.x[i] > params.world_width) {
+                blobs.x[i] = params.world_width;
+                blobs.vx[i] *= wall_factor;
+            }
+            if (blobs.y[i] < 0.0f) {
+                blobs.y[i] = 0.0f;
+                blobs.vy[i] *= wall_factor;
+            }
+            if (blobs.y[i] > params.world_height) {
+                blobs.y[i] = params.world_height;
+                blobs.vy[i] *= wall_factor;
+            }
+        }
+    }
+
+    static StepFunctions functions() {
+        StepFunctions step;
+        step.interact_per_blob = interact_per_blob;
+        step.interact_symmetric = interact_symmetric;
+        step.integrate = integrate;
+        step.num_species = NumSpecies;
+        return step;
+    }
+};
+
+template <int NumSpecies>
+static StepFunctions select_for_species(Boundary boundary, bool mouse) {
+    if (boundary == Boundary::Bounce) {
+        return mouse ? StepKernels<NumSpecies, Boundary::Bounce, true>::functions()
+                     : StepKernels<NumSpecies, Boundary::Bounce, false>::functions();
+    }
+    return mouse ? StepKernels<NumSpecies, Boundary::Clamp, true>::functions()
+                 : StepKernels<NumSpecies, Boundary::Clamp, false>::functions();
+}
+
+StepFunctions select_step_functions(int num_species, Boundary boundary, bool mouse) {
+    if (num_species <= 2) {
+        return select_for_species<2>(boundary, mouse);
+    }
+    if (num_species <= 4) {
+        return select_for_species<4>(boundary, mouse);
+    }
+    if (num_species <= 8) {
+        return select_for_species<8>(boundary, mouse);
+    }
+    if (num_species <= 16) {
+        return select_for_species<16>(boundary, mouse);
+    }
+    return select_for_species<MAX_SPECIES>(boundary, mouse);
+}
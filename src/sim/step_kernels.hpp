@@ -0,0 +1,48 @@
+#pragma once
+
+#include "blob_store.hpp"
+#include "spatial_grid.hpp"
+
+// largest species count the kernels are instantiated for (species ids are bytes)
+const int MAX_SPECIES = 32;
+
+enum class Boundary {
+    Bounce,  // reflect the velocity off the walls
+    Clamp,   // stop at the walls
+};
+
+// everything one step of the scalar kernels needs besides the blobs and the grid
+struct StepParams {
+    const float* rules;  // num_species x num_species, rules[a * num_species + b] = peak force of b on a
+    int num_species;
+    float max_dist;
+    float min_dist;  // below this the blobs repel regardless of species
+    float repulsion_force;
+    float friction;
+    float world_width;
+    float world_height;
+    float mouse_x;
+    float mouse_y;
+    float mouse_force;
+};
+
+// Scalar step kernels specialized at compile time on the species count, the
+// boundary mode and whether the mouse force is on. The species count sizes a
+// flat std::array copy of the rules, so rule lookups have a constant stride;
+// the boundary and mouse choices remove their branches from the per-blob loop.
+//
+// Kernels are instantiated for 2, 4, 8, 16 and 32 species; a run with another
+// count uses the next larger instantiation (the extra rows are never read).
+struct StepFunctions {
+    // every pair evaluated from both sides, writes only the blob being pushed
+    void (*interact_per_blob)(BlobStore& blobs, const SpatialGrid& grid, const StepParams& params, int start_cell, int end_cell);
+    // every pair evaluated once, deltas for both blobs go into the thread's buffers
+    void (*interact_symmetric)(const BlobStore& blobs, const SpatialGrid& grid, const StepParams& params, int start_cell, int end_cell,
+                               float* dvx, float* dvy);
+    // mouse force, then move, apply friction and handle the walls for blobs [start, end)
+    void (*integrate)(BlobStore& blobs, const StepParams& params, int start, int end);
+    int num_species;  // species count of the instantiation
+};
+
+// num_species must be between 1 and MAX_SPECIES
+StepFunctions select_step_functions(int num_species, Boundary boundary, bool mouse);
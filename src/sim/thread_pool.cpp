@@ -0,0 +1,58 @@
+#include "thread_pool.hpp"
+
+Barrier::Barrier(int count)
+    : count(count) {}
+
+void Barrier::arrive_and_wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned int arrival_generation = generation;
+    if (++waiting == count) {
+        waiting = 0;
+        ++generation;
+        cv.notify_all();
+        return;
+    }
+    cv.wait(lock, [&] { return generation != arrival_generation; });
+}
+
+ThreadPool::ThreadPool(int num_threads)
+    : num_threads(num_threads < 1 ? 1 : num_threads), barrier(this->num_threads) {
+    for (int i = 1; i < this->num_threads; ++i) {
+        workers.push_back(std::thread(&ThreadPool::worker, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stopping = true;
+    barrier.arrive_and_wait();  // release the workers from their start barrier
+    for (auto& thread : workers) {
+        thread.join();
+    }
+}
+
+void ThreadPool::run(const std::vector<Phase>& phases) {
+    this->phases = &phases;
+    barrier.arrive_and_wait();  // start
+    run_phases(0);
+    barrier.arrive_and_wait();  // everyone done, safe to hand back the results
+}
+
+void ThreadPool::worker(int thread) {
+    while (true) {
+        barrier.arrive_and_wait();  // wait for run() or shutdown
+        if (stopping) {
+            return;
+        }
+        run_phases(thread);
+        barrier.arrive_and_wait();
+    }
+}
+
+void ThreadPool::run_phases(int thread) {
+    for (size_t i = 0; i < phases->size(); ++i) {
+        if (i > 0) {
+            barrier.arrive_and_wait();
+        }
+        (*phases)[i](thread);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Reusable barrier: every call to arrive_and_wait() blocks until all `count`
+// threads have arrived, then releases them and resets for the next round.
+class Barrier {
+public:
+    explicit Barrier(int count);
+
+    void arrive_and_wait();
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int count;
+    int waiting = 0;
+    unsigned int generation = 0;
+};
+
+// A phase is called once on every thread of the pool with that thread's index.
+typedef std::function<void(int)> Phase;
+
+// Persistent pool of worker threads, created once and reused every frame.
+// run() executes a list of phases on all threads, with a barrier between
+// consecutive phases, so a phase only starts once every thread has finished
+// the previous one. The calling thread takes part as thread 0.
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return num_threads; }
+
+    void run(const std::vector<Phase>& phases);
+
+    // [begin, end) share of n items for thread t
+    int range_begin(int t, int n) const { return static_cast<long long>(t) * n / num_threads; }
+    int range_end(int t, int n) const { return static_cast<long long>(t + 1) * n / num_threads; }
+
+private:
+    void worker(int thread);
+    void run_phases(int thread);
+
+    int num_threads;
+    Barrier barrier;
+    std::vector<std::thread> workers;
+    const std::vector<Phase>* phases = nullptr;
+    bool stopping = false;
+};
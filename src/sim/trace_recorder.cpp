@@ -0,0 +1,107 @@
+#include "trace_recorder.hpp"
+
+#include <fstream>
+
+TraceRecorder::TraceRecorder(int num_threads, int events_per_thread)
+    : events_per_thread(events_per_thread), threads(num_threads < 1 ? 1 : num_threads) {
+    for (size_t t = 0; t < threads.size(); ++t) {
+        threads[t].events.resize(events_per_thread);
+        thread_names.push_back(t == 0 ? "main" : "worker " + std::to_string(t));
+    }
+}
+
+void TraceRecorder::start(int num_frames) {
+    for (ThreadEvents& thread : threads) {
+        thread.count.store(0, std::memory_order_relaxed);
+    }
+    frames_recorded.store(0, std::memory_order_relaxed);
+    epoch = Clock::now();
+    frame_start = epoch;
+    // the other threads start recording once they see this
+    frames_left.store(num_frames, std::memory_order_release);
+}
+
+void TraceRecorder::record(int thread, const char* name, Clock::time_point begin, Clock::time_point end,
+                           int range_begin, int range_end, int blobs, int tasks, int stolen) {
+    // read the count only after seeing the recording start, so it is never one from
+    // before start() reset it
+    if (!recording()) {
+        return;
+    }
+    ThreadEvents& events = threads[thread];
+    int count = events.count.load(std::memory_order_relaxed);
+    if (count == events_per_thread) {
+        return;
+    }
+    Event& event = events.events[count];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.frame = frames_recorded.load(std::memory_order_relaxed);
+    event.range_begin = range_begin;
+    event.range_end = range_end;
+    event.blobs = blobs;
+    event.tasks = tasks;
+    event.stolen = stolen;
+    events.count.store(count + 1, std::memory_order_release);
+}
+
+void TraceRecorder::end_frame(int thread) {
+    if (!recording()) {
+        return;
+    }
+    Clock::time_point now = Clock::now();
+    record(thread, "frame", frame_start, now);
+    frame_start = now;
+    ++frames_recorded;
+    --frames_left;
+}
+
+static double microseconds(TraceRecorder::Clock::duration duration) {
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+bool TraceRecorder::write_chrome_json(const std::string& path) {
+    std::ofstream out(path.c_str());
+    if (!out) {
+        return false;
+    }
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first_event = true;
+    for (size_t t = 0; t < threads.size(); ++t) {
+        if (!first_event) {
+            out << ",\n";
+        }
+        first_event = false;
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+            << ", \"args\": {\"name\": \"" << thread_names[t] << "\"}}";
+        int count = threads[t].count.load(std::memory_order_acquire);
+        for (int i = 0; i < count; ++i) {
+            const Event& event = threads[t].events[i];
+            out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t
+                << ", \"ts\": " << microseconds(event.begin - epoch)
+                << ", \"dur\": " << microseconds(event.end - event.begin)
+                << ", \"args\": {\"frame\": " << event.frame;
+            if (event.range_begin >= 0) {
+                out << ", \"begin\": " << event.range_begin;
+            }
+            if (event.range_end >= 0) {
+                out << ", \"end\": " << event.range_end;
+            }
+            if (event.blobs >= 0) {
+                out << ", \"blobs\": " << event.blobs;
+            }
+            if (event.tasks >= 0) {
+                out << ", \"tasks\": " << event.tasks;
+            }
+            if (event.stolen >= 0) {
+                out << ", \"stolen\": " << event.stolen;
+            }
+            out << "}}";
+        }
+    }
+    out << "\n]}\n";
+
+    frames_recorded = 0;
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Records what every thread did during a window of frames and writes it as
+// Chrome trace-event JSON (load it in chrome://tracing or ui.perfetto.dev), to
+// see how evenly the work of each phase is spread over the threads.
+//
+// Each span carries the range of items (blobs, cells, lists) the thread
+// worked on and how many blobs that was; a work-stealing phase has no single
+// range, so its spans carry the blobs, the tasks the thread ran and how many
+// of them it stole instead. Every thread appends to its own
+// buffer, allocated up front; once a buffer is full further spans of that
+// thread are dropped. Spans are only kept between start() and the end of the
+// frame window, so the recorder costs one branch per phase otherwise.
+//
+// start(), end_frame() and write_chrome_json() belong to one thread (the one
+// owning the frame loop); record() may be called from any thread, each with
+// its own thread index, also while another thread runs the frame loop.
+class TraceRecorder {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TraceRecorder(int num_threads, int events_per_thread = 1 << 16);
+
+    // record the next num_frames frames, dropping any earlier recording
+    void start(int num_frames);
+    bool recording() const { return frames_left.load(std::memory_order_acquire) > 0; }
+    // the window is over and has not been written yet
+    bool finished() const { return !recording() && frames_recorded > 0; }
+
+    // name must outlive the recorder (a string literal); [range_begin, range_end) is the
+    // share of items the thread worked on; negative annotations are left out
+    void record(int thread, const char* name, Clock::time_point begin, Clock::time_point end,
+                int range_begin = -1, int range_end = -1, int blobs = -1, int tasks = -1, int stolen = -1);
+
+    // call once per frame, on the thread that owns the frame loop; the frame
+    // span is recorded as that thread's
+    void end_frame(int thread = 0);
+
+    // name shown for thread in the trace, "main" and "worker <t>" by default
+    void set_thread_name(int thread, const std::string& name) { thread_names[thread] = name; }
+
+    // write the recorded window and clear it
+    bool write_chrome_json(const std::string& path);
+
+private:
+    struct Event {
+        const char* name;
+        Clock::time_point begin;
+        Clock::time_point end;
+        int frame;  // within the window
+        int range_begin;
+        int range_end;
+        int blobs;
+        int tasks;
+        int stolen;
+    };
+
+    struct ThreadEvents {
+        std::vector<Event> events;
+        std::atomic<int> count{0};  // only the recording thread writes it
+    };
+
+    int events_per_thread;
+    std::vector<ThreadEvents> threads;
+    std::vector<std::string> thread_names;
+    std::atomic<int> frames_left{0};
+    std::atomic<int> frames_recorded{0};
+    Clock::time_point epoch;
+    Clock::time_point frame_start;
+};
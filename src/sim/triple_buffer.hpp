@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free hand-off of the latest value from one producer thread to one
+// consumer thread. The producer fills write_buffer() and publish()es it; the
+// consumer calls acquire() and reads read_buffer(), which is the newest
+// published value. Neither side ever waits for the other: values the consumer
+// did not get to in time are simply overwritten.
+//
+// Three buffers rotate between the roles back (being written), middle (the
+// latest published value) and front (being read). publish() swaps back and
+// middle and acquire() swaps middle and front, each with a single atomic
+// exchange of the middle index plus a "fresh" flag.
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // producer side
+    T& write_buffer() { return buffers[back]; }
+    void publish() {
+        int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = old & INDEX;
+    }
+
+    // consumer side: true if something was published since the last call,
+    // read_buffer() is then the newest value; it stays valid until the next acquire()
+    bool acquire() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        int old = middle.exchange(front, std::memory_order_acq_rel);
+        front = old & INDEX;
+        return true;
+    }
+    const T& read_buffer() const { return buffers[front]; }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T buffers[3];
+    alignas(64) std::atomic<int> middle{1};
+    alignas(64) int back = 0;   // producer only
+    alignas(64) int front = 2;  // consumer only
+};
@@ -0,0 +1,65 @@
+#include "work_stealing.hpp"
+
+#include <new>
+
+WorkStealingScheduler::WorkStealingScheduler(int num_threads) {
+    resize(num_threads);
+}
+
+void WorkStealingScheduler::resize(int num_threads) {
+    num_workers = num_threads < 1 ? 1 : num_threads;
+    // std::vector does not honor alignas before C++17, so align by hand
+    storage.assign((num_workers + 1) * sizeof(Worker), 0);
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    workers = reinterpret_cast<Worker*>((address + CACHE_LINE - 1) & ~static_cast<uintptr_t>(CACHE_LINE - 1));
+    for (int t = 0; t < num_workers; ++t) {
+        new (&workers[t]) Worker();
+        workers[t].random_state = 2654435761u * (t + 1);  // distinct nonzero xorshift seeds
+    }
+}
+
+void WorkStealingScheduler::reset_counters() {
+    for (int t = 0; t < num_workers; ++t) {
+        workers[t].stolen = 0;
+        workers[t].executed = 0;
+    }
+}
+
+// take the task at the head of this thread's own deque
+bool WorkStealingScheduler::pop(int thread, uint32_t& task) {
+    std::atomic<uint64_t>& range = workers[thread].range;
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (head_of(current) < tail_of(current)) {
+        if (range.compare_exchange_weak(current, pack(head_of(current) + 1, tail_of(current)), std::memory_order_acq_rel)) {
+            task = head_of(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+// take a task from the tail of another thread's deque: visit the others in
+// order, starting at a random one, and give up once all of them are empty
+bool WorkStealingScheduler::steal(int thread, uint32_t& task) {
+    int num_threads = num_workers;
+    if (num_threads == 1) {
+        return false;
+    }
+    uint32_t& state = workers[thread].random_state;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    int start = state % (num_threads - 1);
+    for (int k = 0; k < num_threads - 1; ++k) {
+        int victim = (thread + 1 + (start + k) % (num_threads - 1)) % num_threads;
+        std::atomic<uint64_t>& range = workers[victim].range;
+        uint64_t current = range.load(std::memory_order_acquire);
+        while (head_of(current) < tail_of(current)) {
+            if (range.compare_exchange_weak(current, pack(head_of(current), tail_of(current) - 1), std::memory_order_acq_rel)) {
+                task = tail_of(current) - 1;
+                return true;
+            }
+        }
+    }
+    return false;
+}
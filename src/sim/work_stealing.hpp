@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// Work-stealing scheduler for the phases of a ThreadPool. A phase splits its
+// items into small tasks (tiles of cells, chunks of blobs); every thread seeds
+// its own deque with a contiguous run of tasks, works through it from the
+// front, and once it is empty steals single tasks from the back of randomly
+// picked other threads until every deque is empty. Tasks must be independent
+// of which thread runs them.
+//
+// A deque is a [head, tail) range of task indices packed into one 64-bit
+// atomic, so the owner taking from the head and thieves taking from the tail
+// both claim a task with a single compare-and-swap. A thread reseeds only its
+// own deque, at the start of run(); since every deque is empty when a phase
+// ends, a thief that looks before the owner has seeded just finds nothing.
+class WorkStealingScheduler {
+public:
+    explicit WorkStealingScheduler(int num_threads = 1);
+
+    WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+    void resize(int num_threads);
+
+    // called by every thread of the phase: seed this thread's deque with tasks
+    // [first, last), then call task(index) until no thread has tasks left
+    template <class Task>
+    void run(int thread, int first, int last, const Task& task);
+
+    // tasks run by thread that it took from other threads' deques, and all
+    // tasks it ran, since the last reset_counters()
+    long long stolen_tasks(int thread) const { return workers[thread].stolen; }
+    long long executed_tasks(int thread) const { return workers[thread].executed; }
+    void reset_counters();
+
+private:
+    // one cache line per thread, the deques are hammered by every thread
+    static const int CACHE_LINE = 64;
+    struct alignas(CACHE_LINE) Worker {
+        std::atomic<uint64_t> range{0};  // head in the low 32 bits, tail in the high 32 bits
+        long long stolen = 0;
+        long long executed = 0;
+        uint32_t random_state = 1;
+    };
+
+    static uint64_t pack(uint32_t head, uint32_t tail) { return static_cast<uint64_t>(tail) << 32 | head; }
+    static uint32_t head_of(uint64_t range) { return static_cast<uint32_t>(range); }
+    static uint32_t tail_of(uint64_t range) { return static_cast<uint32_t>(range >> 32); }
+
+    bool pop(int thread, uint32_t& task);
+    bool steal(int thread, uint32_t& task);
+
+    int num_workers = 0;
+    std::vector<unsigned char> storage;
+    Worker* workers = nullptr;  // storage aligned up to a cache line
+};
+
+template <class Task>
+void WorkStealingScheduler::run(int thread, int first, int last, const Task& task) {
+    Worker& self = workers[thread];
+    self.range.store(pack(first, last > first ? last : first), std::memory_order_release);
+    uint32_t index;
+    while (pop(thread, index)) {
+        task(index);
+        ++self.executed;
+    }
+    while (steal(thread, index)) {
+        task(index);
+        ++self.executed;
+        ++self.stolen;
+    }
+}
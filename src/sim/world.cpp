@@ -0,0 +1,500 @@
+#include "world.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// splitmix64 finalizer
+static uint64_t mix_bits(uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t float_pair_bits(float a, float b) {
+    uint32_t a_bits, b_bits;
+    std::memcpy(&a_bits, &a, sizeof(a_bits));
+    std::memcpy(&b_bits, &b, sizeof(b_bits));
+    return static_cast<uint64_t>(a_bits) << 32 | b_bits;
+}
+
+// Sum of one hash per blob, so chunks can be hashed by any thread in any
+// order and still add up to the same checksum.
+static uint64_t hash_blobs(const BlobStore& blobs, int start, int end) {
+    uint64_t sum = 0;
+    for (int i = start; i < end; ++i) {
+        uint64_t hash = mix_bits(static_cast<uint64_t>(i) << 8 | blobs.species[i]);
+        hash = mix_bits(hash ^ float_pair_bits(blobs.x[i], blobs.y[i]));
+        hash = mix_bits(hash ^ float_pair_bits(blobs.vx[i], blobs.vy[i]));
+        sum += hash;
+    }
+    return sum;
+}
+
+// round to the nearest multiple of 1 / scale (a power of two, so it is exact)
+static void snap_to_fixed_point(BlobStore& blobs, float scale, int start, int end) {
+    for (int i = start; i < end; ++i) {
+        blobs.x[i] = std::nearbyint(blobs.x[i] * scale) / scale;
+        blobs.y[i] = std::nearbyint(blobs.y[i] * scale) / scale;
+        blobs.vx[i] = std::nearbyint(blobs.vx[i] * scale) / scale;
+        blobs.vy[i] = std::nearbyint(blobs.vy[i] * scale) / scale;
+    }
+}
+
+const char* step_stage_name(StepStage stage) {
+    switch (stage) {
+        case StepStage::Grid: return "grid";
+        case StepStage::Lists: return "lists";
+        case StepStage::Interaction: return "interaction";
+        case StepStage::Reduce: return "reduce";
+        case StepStage::Reorder: return "reorder";
+        case StepStage::Integrate: return "integrate";
+    }
+    return "unknown";
+}
+
+World::World(const WorldParams& params)
+    : world_params(params), thread_pool(params.num_threads), task_scheduler(thread_pool.size()) {
+    isa = detect_kernel_isa();
+    if (world_params.deterministic) {
+        // per-blob sums in cell order; the SIMD kernels sum in lanes, so their
+        // rounding depends on the ISA, and the symmetric and list modes depend
+        // on which thread found a pair
+        world_params.interaction_mode = InteractionMode::Vectorized;
+        isa = KernelIsa::Scalar;
+    }
+    cell_kernel = select_cell_kernel(isa);
+    list_kernel = select_list_kernel(isa);
+    use_lists = world_params.interaction_mode == InteractionMode::NeighborLists;
+    use_accumulator = world_params.interaction_mode == InteractionMode::Symmetric;
+    cell_size = use_lists ? world_params.max_dist + world_params.neighbor_skin : world_params.max_dist;  // in pixels
+    thread_displacement_sq.assign(thread_pool.size(), 0.0f);
+    thread_checksum.assign(thread_pool.size(), 0);
+    thread_share_tasks.assign(thread_pool.size(), 0);
+    thread_share_blobs.assign(thread_pool.size(), 0);
+
+    randomize_rules();
+    randomize_blobs();
+    set_boundary(world_params.boundary);
+    build_phases();
+}
+
+void World::randomize_rules() {
+    int num_species = world_params.num_species;
+    std::vector<float> rules(num_species * num_species);
+    RandomStream random(world_params.seed, random_stream(RandomPurpose::Rules, 0, rule_generation++));
+    for (int i = 0; i < num_species * num_species; ++i) {
+        rules[i] = random.uniform(-world_params.max_force, world_params.max_force);  // any force between different species
+    }
+    set_rules(rules);
+}
+
+void World::randomize_blobs() {
+    int num_blobs = world_params.num_blobs;
+    // reuses the storage when the blob count did not change
+    blob_store.resize(num_blobs);
+    LayoutArgs layout = make_layout_args(world_params.layout, world_params.num_species, world_params.world_width,
+                                         world_params.world_height, world_params.seed, blob_generation);
+    BlobPlacer place = select_blob_placer(world_params.layout);
+    // only the interaction mode in use gets its buffers, the accumulator is zeroed below
+    if (use_accumulator) {
+        accumulator.resize(thread_pool.size(), num_blobs);
+    }
+    if (use_lists) {
+        lists.resize(thread_pool.size(), num_blobs);
+    }
+    // one stream per blob, so every thread fills its own share straight into the arrays
+    uint32_t generation = blob_generation++;
+    thread_pool.run({[&](int t) {
+        if (use_accumulator) {
+            accumulator.clear(t);
+        }
+        for (int i = blob_begin(t); i < blob_end(t); ++i) {
+            RandomStream random(world_params.seed, random_stream(RandomPurpose::Blobs, i, generation));
+            float x, y;
+            int species_id;
+            place(layout, random, x, y, species_id);
+            blob_store.x[i] = x;
+            blob_store.y[i] = y;
+            // random small velocity
+            blob_store.vx[i] = random.uniform(-1.0f, 1.0f);
+            blob_store.vy[i] = random.uniform(-1.0f, 1.0f);
+            blob_store.species[i] = static_cast<uint8_t>(species_id);
+            blob_store.id[i] = i;
+            blob_store.slot_of_id[i] = i;
+        }
+    }});
+    lists_stale = true;
+    counts_ready = false;
+    grid_ready = false;
+}
+
+void World::set_rules(const std::vector<float>& rules) {
+    rule_table = rules;
+    force_table.build(rule_table.data(), world_params.num_species, world_params.max_dist,
+                      world_params.blob_size + world_params.blob_size + world_params.repulsion_dist, world_params.repulsion_force);
+}
+
+void World::resize(float world_width, float world_height) {
+    world_params.world_width = world_width;
+    world_params.world_height = world_height;
+    counts_ready = false;  // counted for the old grid
+    grid_ready = false;
+}
+
+void World::set_boundary(Boundary boundary) {
+    world_params.boundary = boundary;
+    step_functions = select_step_functions(world_params.num_species, boundary, mouse_enabled);
+}
+
+void World::set_mouse(float x, float y, bool enabled) {
+    mouse_x = x;
+    mouse_y = y;
+    if (enabled != mouse_enabled) {
+        mouse_enabled = enabled;
+        step_functions = select_step_functions(world_params.num_species, world_params.boundary, mouse_enabled);
+    }
+}
+
+void World::set_profiler(Profiler* profiler, int thread) {
+    this->profiler = profiler;
+    profiler_thread = thread;
+    if (profiler) {
+        for (int stage = 0; stage < NUM_STEP_STAGES; ++stage) {
+            stage_sections[stage] = profiler->section(step_stage_name(static_cast<StepStage>(stage)));
+        }
+    }
+}
+
+StepParams World::make_step_params() const {
+    StepParams params;
+    params.rules = rule_table.data();
+    params.num_species = world_params.num_species;
+    params.max_dist = world_params.max_dist;
+    params.min_dist = world_params.blob_size + world_params.blob_size + world_params.repulsion_dist;
+    params.repulsion_force = world_params.repulsion_force;
+    params.friction = world_params.friction;
+    params.world_width = world_params.world_width;
+    params.world_height = world_params.world_height;
+    params.mouse_x = mouse_x;
+    params.mouse_y = mouse_y;
+    params.mouse_force = world_params.mouse_force;
+    return params;
+}
+
+ForceLookup World::make_force_lookup() const {
+    ForceLookup forces;
+    forces.force_table = force_table.data();
+    forces.num_species = world_params.num_species;
+    forces.table_bits = ForceTable::BITS;
+    forces.table_shift = ForceTable::SHIFT;
+    forces.table_offset = force_table.offset();
+    forces.table_min_d2 = force_table.min_d2();
+    forces.table_max_d2 = force_table.max_d2();
+    forces.max_dist = world_params.max_dist;
+    return forces;
+}
+
+CellKernelArgs World::make_cell_kernel_args() {
+    CellKernelArgs args;
+    args.cell_start = grid.cell_starts();
+    args.cell_items = grid.items();
+    args.x = grid.sorted_x_data();
+    args.y = grid.sorted_y_data();
+    args.species = grid.sorted_species_data();
+    args.grid_width = grid.width();
+    args.grid_height = grid.height();
+    args.forces = make_force_lookup();
+    args.vx = blob_store.vx.data();
+    args.vy = blob_store.vy.data();
+    return args;
+}
+
+ListKernelArgs World::make_list_kernel_args() {
+    ListKernelArgs args;
+    args.list_start = lists.list_starts();
+    args.list_blob = lists.list_blobs();
+    args.neighbors = lists.neighbor_slots();
+    args.neighbor_species = lists.neighbor_species_data();
+    args.x = blob_store.x.data();
+    args.y = blob_store.y.data();
+    args.species = blob_store.species.data();
+    args.forces = make_force_lookup();
+    args.vx = blob_store.vx.data();
+    args.vy = blob_store.vy.data();
+    return args;
+}
+
+int World::list_begin(int t) const {
+    if (t >= thread_pool.size()) {
+        return lists.size();
+    }
+    if (!world_params.balance_work || t == 0) {
+        return thread_pool.range_begin(t, lists.size());
+    }
+    // first list that starts at or after t / num_threads of all neighbors
+    const int* list_start = lists.list_starts();
+    long long target = static_cast<long long>(list_start[lists.size()]) * t / thread_pool.size();
+    return std::lower_bound(list_start, list_start + lists.size(), target) - list_start;
+}
+
+// The pool has a barrier between phases, so when thread 0 starts the first
+// phase of a stage every thread has finished the stage before it.
+Phase World::timed(StepStage stage, Phase phase) {
+    return [this, stage, phase](int t) {
+        if (t == 0) {
+            stage_start[static_cast<int>(stage)] = std::chrono::steady_clock::now();
+        }
+        phase(t);
+    };
+}
+
+void World::count_share(int t, PhaseItems items, int begin, int end) {
+    ++thread_share_tasks[t];
+    if (items == PhaseItems::Cells) {
+        const int* cell_start = grid.cell_starts();
+        thread_share_blobs[t] += cell_start[end] - cell_start[begin];
+    }
+    else {
+        thread_share_blobs[t] += end - begin;  // one list per blob
+    }
+}
+
+Phase World::traced(const char* name, PhaseItems items, const bool* active, Phase phase) {
+    return [this, name, items, active, phase](int t) {
+        if (!tracing || (active && !*active) || (items == PhaseItems::Single && t != 0)) {
+            phase(t);
+            return;
+        }
+        thread_share_tasks[t] = 0;
+        thread_share_blobs[t] = 0;
+        long long stolen_before = task_scheduler.stolen_tasks(t);
+        TraceRecorder::Clock::time_point begin = TraceRecorder::Clock::now();
+        phase(t);
+        TraceRecorder::Clock::time_point end = TraceRecorder::Clock::now();
+        if (world_params.work_stealing && thread_share_tasks[t] > 0) {
+            // the tasks this thread ran, which need not be its static share
+            int stolen = static_cast<int>(task_scheduler.stolen_tasks(t) - stolen_before);
+            tracer->record(t, name, begin, end, -1, -1, thread_share_blobs[t], thread_share_tasks[t], stolen);
+        }
+        else if (items == PhaseItems::Blobs) {
+            tracer->record(t, name, begin, end, blob_begin(t), blob_end(t), blob_end(t) - blob_begin(t));
+        }
+        else if (items == PhaseItems::Cells) {
+            const int* cell_start = grid.cell_starts();
+            tracer->record(t, name, begin, end, cell_begin(t), cell_end(t), cell_start[cell_end(t)] - cell_start[cell_begin(t)]);
+        }
+        else if (items == PhaseItems::Lists) {
+            tracer->record(t, name, begin, end, list_begin(t), list_end(t), list_end(t) - list_begin(t));
+        }
+        else {
+            tracer->record(t, name, begin, end);
+        }
+    };
+}
+
+void World::integrate_range(int t, int begin, int end) {
+    step_functions.integrate(blob_store, step_params, begin, end);
+    if (world_params.deterministic) {
+        if (world_params.fixed_point_bits > 0) {
+            snap_to_fixed_point(blob_store, std::ldexp(1.0f, world_params.fixed_point_bits), begin, end);
+        }
+        thread_checksum[t] += hash_blobs(blob_store, begin, end);
+    }
+    if (use_lists) {
+        thread_displacement_sq[t] = std::max(thread_displacement_sq[t], lists.max_displacement_sq(blob_store, begin, end));
+    }
+}
+
+// one step of the simulation, run on every thread of the pool
+void World::build_phases() {
+    PhaseItems interaction_items = use_lists ? PhaseItems::Lists : PhaseItems::Cells;
+    // bin blobs into the grid: per-thread histograms, prefix sum, then scatter
+    Phase grid_count = traced("grid.count", PhaseItems::Blobs, &count_grid, [this](int t) {
+        if (count_grid) {
+            grid.clear_counts(t);
+            grid.count(blob_store, t, blob_begin(t), blob_end(t));
+        }
+    });
+    Phase grid_prefix_sum = traced("grid.prefix_sum", PhaseItems::Single, &build_grid, [this](int t) {
+        if (build_grid && t == 0) {
+            grid.prefix_sum();
+        }
+    });
+    Phase grid_scatter = traced("grid.scatter", PhaseItems::Blobs, &build_grid, [this](int t) {
+        if (build_grid) {
+            grid.scatter(blob_store, t, blob_begin(t), blob_end(t));
+            if (world_params.balance_work) {
+                // the histogram is final after the prefix sum, the cell ranges are ready after the barrier
+                partition.estimate(grid, t, thread_pool.range_begin(t, grid_size), thread_pool.range_end(t, grid_size));
+            }
+        }
+    });
+    grid_phases = {grid_count, grid_prefix_sum, grid_scatter};
+    step_phases = {
+        timed(StepStage::Grid, grid_count),
+        grid_prefix_sum,
+        grid_scatter,
+        // collect every blob's neighbors within max_dist + neighbor_skin
+        timed(StepStage::Lists, traced("lists.build", PhaseItems::Cells, &rebuild_lists, [this](int t) {
+            if (rebuild_lists) {
+                lists.build(grid, cell_size, t, cell_begin(t), cell_end(t));
+            }
+        })),
+        traced("lists.prefix_sum", PhaseItems::Single, &rebuild_lists, [this](int t) {
+            if (rebuild_lists && t == 0) {
+                lists.prefix_sum();
+            }
+        }),
+        traced("lists.merge", PhaseItems::Cells, &rebuild_lists, [this](int t) {
+            if (rebuild_lists) {
+                lists.merge(blob_store, t);
+            }
+        }),
+        timed(StepStage::Interaction, traced("interaction", interaction_items, nullptr, [this](int t) {
+            InteractionMode mode = world_params.interaction_mode;
+            if (mode == InteractionMode::NeighborLists) {
+                ListKernelArgs args = make_list_kernel_args();
+                for_share(t, PhaseItems::Lists, lists.size(), INTERACTION_TILE_LISTS, list_begin(t), list_end(t), [&](int begin, int end) {
+                    list_kernel(args, begin, end);
+                });
+            }
+            else if (mode == InteractionMode::Vectorized) {
+                CellKernelArgs args = make_cell_kernel_args();
+                for_share(t, PhaseItems::Cells, grid_size, INTERACTION_TILE_CELLS, cell_begin(t), cell_end(t), [&](int begin, int end) {
+                    cell_kernel(args, begin, end);
+                });
+            }
+            else if (mode == InteractionMode::Symmetric) {
+                // deltas go into the buffers of whichever thread runs the tile
+                for_share(t, PhaseItems::Cells, grid_size, INTERACTION_TILE_CELLS, cell_begin(t), cell_end(t), [&](int begin, int end) {
+                    step_functions.interact_symmetric(blob_store, grid, step_params, begin, end, accumulator.dvx(t), accumulator.dvy(t));
+                });
+            }
+            else {
+                for_share(t, PhaseItems::Cells, grid_size, INTERACTION_TILE_CELLS, cell_begin(t), cell_end(t), [&](int begin, int end) {
+                    step_functions.interact_per_blob(blob_store, grid, step_params, begin, end);
+                });
+            }
+        })),
+        timed(StepStage::Reduce, traced("reduce", PhaseItems::Blobs, &use_accumulator, [this](int t) {
+            if (use_accumulator) {
+                for_share(t, PhaseItems::Blobs, blob_store.size(), BLOB_CHUNK, blob_begin(t), blob_end(t), [&](int begin, int end) {
+                    accumulator.reduce(blob_store, begin, end);
+                });
+            }
+        })),
+        // every reorder_interval steps, permute the blobs into spatial order using this step's grid
+        timed(StepStage::Reorder, traced("reorder.plan", PhaseItems::Single, &reorder_now, [this](int t) {
+            if (reorder_now && t == 0) {
+                reorder.plan(grid, blob_store.size(), world_params.blob_order);
+            }
+        })),
+        traced("reorder.gather", PhaseItems::Blobs, &reorder_now, [this](int t) {
+            if (reorder_now) {
+                reorder.gather(blob_store, blob_begin(t), blob_end(t));
+            }
+        }),
+        traced("reorder.commit", PhaseItems::Single, &reorder_now, [this](int t) {
+            if (reorder_now && t == 0) {
+                reorder.commit(blob_store);
+            }
+        }),
+        timed(StepStage::Integrate, traced("integrate", PhaseItems::Blobs, nullptr, [this](int t) {
+            thread_displacement_sq[t] = 0.0f;
+            thread_checksum[t] = 0;
+            if (world_params.fuse_binning) {
+                // count each chunk while it is still in cache from integrating it
+                grid.clear_counts(t);
+                for (int begin = blob_begin(t); begin < blob_end(t); begin += BLOB_CHUNK) {
+                    int end = std::min(blob_end(t), begin + BLOB_CHUNK);
+                    integrate_range(t, begin, end);
+                    grid.count(blob_store, t, begin, end);
+                }
+            }
+            else {
+                for_share(t, PhaseItems::Blobs, blob_store.size(), BLOB_CHUNK, blob_begin(t), blob_end(t), [&](int begin, int end) {
+                    integrate_range(t, begin, end);
+                });
+            }
+        })),
+    };
+}
+
+void World::prepare_grid() {
+    grid.resize(world_params.world_width, world_params.world_height, cell_size, blob_store.size(), thread_pool.size());
+    grid_size = grid.num_cells();
+    partition.resize(thread_pool.size(), grid_size);
+}
+
+void World::step(int num_steps) {
+    for (int s = 0; s < num_steps; ++s) {
+        prepare_grid();
+        reorder_now = world_params.blob_order != BlobOrder::None && step_count % world_params.reorder_interval == 0;
+        if (use_lists) {
+            float max_displacement_sq = *std::max_element(thread_displacement_sq.begin(), thread_displacement_sq.end());
+            float half_skin = world_params.neighbor_skin / 2;
+            rebuild_lists = lists_stale || max_displacement_sq > half_skin * half_skin;
+            // the lists refer to blob slots, a reorder invalidates them
+            lists_stale = reorder_now;
+        }
+        build_grid = !grid_ready && (!use_lists || rebuild_lists || reorder_now);
+        count_grid = build_grid && !counts_ready;
+        step_params = make_step_params();
+        tracing = tracer && tracer->recording();
+
+        std::chrono::steady_clock::time_point step_start = std::chrono::steady_clock::now();
+        thread_pool.run(step_phases);
+        counts_ready = world_params.fuse_binning;
+        grid_ready = false;
+        std::chrono::steady_clock::time_point step_end = std::chrono::steady_clock::now();
+        for (int stage = 0; stage < NUM_STEP_STAGES; ++stage) {
+            std::chrono::steady_clock::time_point stage_end = stage + 1 < NUM_STEP_STAGES ? stage_start[stage + 1] : step_end;
+            last_timing.stage_seconds[stage] = std::chrono::duration<double>(stage_end - stage_start[stage]).count();
+            if (profiler) {
+                profiler->record(profiler_thread, stage_sections[stage], stage_start[stage], stage_end);
+            }
+        }
+        last_timing.total_seconds = std::chrono::duration<double>(step_end - step_start).count();
+        if (world_params.deterministic) {
+            state_checksum = 0;
+            for (uint64_t sum : thread_checksum) {
+                state_checksum += sum;
+            }
+        }
+        ++step_count;
+    }
+}
+
+CellWindow cells_in_rect(const WorldSnapshot& snapshot, float left, float top, float width, float height) {
+    CellWindow cells;
+    cells.first_x = std::max(static_cast<int>(std::floor(left / snapshot.cell_size)), 0);
+    cells.last_x = std::min(static_cast<int>(std::floor((left + width) / snapshot.cell_size)), snapshot.grid_width - 1);
+    cells.first_y = std::max(static_cast<int>(std::floor(top / snapshot.cell_size)), 0);
+    cells.last_y = std::min(static_cast<int>(std::floor((top + height) / snapshot.cell_size)), snapshot.grid_height - 1);
+    return cells;
+}
+
+// The grid of the current positions is the one the next step starts with, so
+// build it here (counting only if the integrate pass did not) and let the next
+// step skip it; the snapshot is then a copy of its cell-ordered arrays.
+void World::snapshot(WorldSnapshot& snapshot) {
+    if (!grid_ready) {
+        prepare_grid();
+        build_grid = true;
+        count_grid = !counts_ready;
+        tracing = tracer && tracer->recording();
+        thread_pool.run(grid_phases);
+        grid_ready = true;
+    }
+    const int* cell_start = grid.cell_starts();
+    int num_binned = cell_start[grid_size];
+    snapshot.x.assign(grid.sorted_x_data(), grid.sorted_x_data() + num_binned);
+    snapshot.y.assign(grid.sorted_y_data(), grid.sorted_y_data() + num_binned);
+    snapshot.species.assign(grid.sorted_species_data(), grid.sorted_species_data() + num_binned);
+    snapshot.cell_start.assign(cell_start, cell_start + grid_size + 1);
+    snapshot.grid_width = grid.width();
+    snapshot.grid_height = grid.height();
+    snapshot.cell_size = cell_size;
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "blob_layout.hpp"
+#include "blob_store.hpp"
+#include "cell_kernels.hpp"
+#include "cell_partition.hpp"
+#include "force_accumulator.hpp"
+#include "force_table.hpp"
+#include "neighbor_list.hpp"
+#include "profiler.hpp"
+#include "random.hpp"
+#include "reorder.hpp"
+#include "spatial_grid.hpp"
+#include "step_kernels.hpp"
+#include "thread_pool.hpp"
+#include "trace_recorder.hpp"
+#include "work_stealing.hpp"
+
+enum class InteractionMode {
+    PerBlob,     // every pair evaluated twice, once from each side
+    Symmetric,   // every pair evaluated once, forces applied to both blobs
+    Vectorized,  // cell-span SIMD kernel, picked for the CPU at startup
+    NeighborLists,  // Verlet lists rebuilt only when blobs moved far enough, walked with SIMD gathers
+};
+
+// Everything that shapes a world. Fixed for the lifetime of a World, except
+// where World has a setter.
+struct WorldParams {
+    int num_blobs = 5000;
+    int num_species = 4;  // 2 to MAX_SPECIES
+    int num_threads = 1;
+    BlobLayout layout = BlobLayout::Uniform;  // where randomize_blobs() puts the blobs
+    float world_width = 1000.0f;
+    float world_height = 1000.0f;
+
+    float max_force = 0.05f;  // rules are drawn from [-max_force, max_force]
+    float max_dist = 30.0f;
+    float friction = 0.9f;
+    float blob_size = 2.5f;
+    float repulsion_dist = 5.0f;  // blobs closer than 2 * blob_size + repulsion_dist push each other away
+    float repulsion_force = 0.9f;
+    float mouse_force = -0.5f;
+    Boundary boundary = Boundary::Bounce;
+
+    InteractionMode interaction_mode = InteractionMode::Vectorized;
+    BlobOrder blob_order = BlobOrder::Morton;  // BlobOrder::None to keep creation order
+    int reorder_interval = 20;  // steps between spatial reorders of the blob arrays
+    float neighbor_skin = 6.0f;  // extra list radius, lists are rebuilt once a blob moved half of it
+    // give threads equal shares of estimated pair work (cells) or neighbors (lists)
+    // instead of equal numbers of cells or lists
+    bool balance_work = true;
+    // split the interaction, reduce and integrate phases into small tasks that idle
+    // threads steal from busy ones; the balanced ranges above become the initial shares
+    bool work_stealing = true;
+    // bin every blob into the next step's grid right after integrating it, so the
+    // step's first phase has nothing left to count; the integrate phase then runs
+    // on the static blob shares, which the grid's per-thread histograms need
+    bool fuse_binning = true;
+
+    // Bit-identical trajectories for a given seed, whatever the thread count,
+    // partition or CPU: every blob sums its forces in a fixed neighbor order
+    // (the scalar cell kernel, whatever interaction_mode says), and a checksum
+    // of the state is computed every step.
+    bool deterministic = false;
+    // deterministic mode only: round positions and velocities to multiples of
+    // 2^-fixed_point_bits after every step, so the state is exactly a fixed-point
+    // value (0 keeps full floats)
+    int fixed_point_bits = 0;
+    uint64_t seed = 1;  // of every random stream of the world (rules, blobs)
+};
+
+// task sizes for work stealing
+const int INTERACTION_TILE_CELLS = 16;
+const int INTERACTION_TILE_LISTS = 256;
+const int BLOB_CHUNK = 2048;
+
+// Stages of World::step(), in pipeline order. Each stage is one or more pool phases.
+enum class StepStage {
+    Grid,         // count, prefix sum, scatter
+    Lists,        // neighbor list build, only does work in list mode
+    Interaction,  // pair forces into the velocities (or the accumulator)
+    Reduce,       // accumulator into the velocities, symmetric mode only
+    Reorder,      // spatial reorder of the blob storage, every reorder_interval steps
+    Integrate,    // mouse force, movement, friction and walls, and the next step's grid count
+};
+const int NUM_STEP_STAGES = 6;
+
+const char* step_stage_name(StepStage stage);
+
+// Wall time of each stage of one step, barriers included, so the stages add up to the step.
+struct StepTiming {
+    double stage_seconds[NUM_STEP_STAGES];
+    double total_seconds;
+};
+
+// Positions and species of the blobs at one point in time, in grid cell order:
+// the blobs of cell c are [cell_start[c], cell_start[c + 1]), so a part of the
+// world can be read without looking at the rest. Blobs outside the world
+// bounds (only possible right after a resize) are left out.
+struct WorldSnapshot {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<uint8_t> species;
+    std::vector<int> cell_start;  // num cells + 1
+    int grid_width = 0;  // in cells
+    int grid_height = 0;
+    float cell_size = 1.0f;  // in world units
+};
+
+// The cells of a snapshot's grid that a rectangle of the world touches:
+// columns [first_x, last_x] of rows [first_y, last_y]. The snapshot is in cell
+// order, so the blobs of those columns in one row are a single range.
+struct CellWindow {
+    int first_x = 0;
+    int last_x = -1;
+    int first_y = 0;
+    int last_y = -1;
+
+    int num_rows() const { return first_x <= last_x ? std::max(last_y - first_y + 1, 0) : 0; }
+};
+
+CellWindow cells_in_rect(const WorldSnapshot& snapshot, float left, float top, float width, float height);
+
+// first blob of the n-th row of the window, and one past its last
+inline int row_begin(const WorldSnapshot& snapshot, const CellWindow& cells, int n) {
+    return snapshot.cell_start[(cells.first_y + n) * snapshot.grid_width + cells.first_x];
+}
+
+inline int row_end(const WorldSnapshot& snapshot, const CellWindow& cells, int n) {
+    return snapshot.cell_start[(cells.first_y + n) * snapshot.grid_width + cells.last_x + 1];
+}
+
+// One self-contained simulation: owns its blobs, rules, grid, kernels and
+// thread pool, so several worlds can live in one process. step() runs the
+// whole pipeline on the pool:
+//   grid build -> (neighbor lists) -> interaction -> (reduce) -> (reorder) -> mouse + integrate (+ next grid count)
+class World {
+public:
+    explicit World(const WorldParams& params);
+
+    World(const World&) = delete;
+    World& operator=(const World&) = delete;
+
+    const WorldParams& params() const { return world_params; }
+
+    // new random rules, and new random blobs with the current species count and
+    // layout, filled in parallel on the pool; every call draws from new streams of the seed
+    void randomize_rules();
+    void randomize_blobs();
+
+    // num_species x num_species, rules()[a * num_species + b] = peak force of b on a
+    const std::vector<float>& rules() const { return rule_table; }
+    void set_rules(const std::vector<float>& rules);
+
+    // blobs outside the new bounds are pushed back in by the next step
+    void resize(float world_width, float world_height);
+    void set_boundary(Boundary boundary);
+    // the mouse pulls (or pushes) blobs within max_dist while enabled
+    void set_mouse(float x, float y, bool enabled);
+
+    void step(int num_steps = 1);
+
+    // copy the current blob positions into snapshot, reusing its storage; builds
+    // the grid the next step would start with, so it costs little beyond the copy
+    void snapshot(WorldSnapshot& snapshot);
+
+    // live blob storage, only valid to read between steps
+    const BlobStore& blobs() const { return blob_store; }
+    int num_blobs() const { return blob_store.size(); }
+    long long steps_taken() const { return step_count; }
+    // stage times of the most recent step
+    const StepTiming& last_step_timing() const { return last_timing; }
+    // hash of every blob's slot, position, velocity and species after the most
+    // recent step; only computed in deterministic mode (0 otherwise)
+    uint64_t checksum() const { return state_checksum; }
+    // also record every stage as a section of profiler, as thread `thread`
+    // (the thread calling step()); nullptr to stop
+    void set_profiler(Profiler* profiler, int thread = 0);
+    // record every phase on every pool thread into tracer while it is recording;
+    // the pool's thread t is the tracer's thread t. nullptr to stop
+    void set_trace_recorder(TraceRecorder* tracer) { this->tracer = tracer; }
+
+    // the world's threads, free to run other phases between steps
+    ThreadPool& pool() { return thread_pool; }
+    // stolen/executed task counters of the world's phases, per pool thread
+    WorkStealingScheduler& scheduler() { return task_scheduler; }
+    KernelIsa kernel_isa() const { return isa; }
+
+private:
+    // what the items of a phase are, for the trace annotations
+    enum class PhaseItems {
+        Blobs,  // the thread's share of the blobs
+        Cells,  // the thread's share of the grid cells
+        Lists,  // the thread's share of the neighbor lists
+        Single, // thread 0 does all the work
+    };
+
+    void build_phases();
+    void prepare_grid();
+    // integrate blobs [begin, end) on thread t, plus what deterministic and list mode need afterwards
+    void integrate_range(int t, int begin, int end);
+    Phase timed(StepStage stage, Phase phase);
+    // record the phase to the tracer when it does work (active is null or true)
+    Phase traced(const char* name, PhaseItems items, const bool* active, Phase phase);
+    // thread t's share of the blobs, grid cells and neighbor lists
+    int blob_begin(int t) const { return thread_pool.range_begin(t, blob_store.size()); }
+    int blob_end(int t) const { return thread_pool.range_end(t, blob_store.size()); }
+    int cell_begin(int t) const { return world_params.balance_work ? partition.begin(t) : thread_pool.range_begin(t, grid_size); }
+    int cell_end(int t) const { return world_params.balance_work ? partition.end(t) : thread_pool.range_end(t, grid_size); }
+    int list_begin(int t) const;
+    int list_end(int t) const { return list_begin(t + 1); }
+
+    // Call task(begin, end) for thread t's part of n items. Statically that is
+    // [share_begin, share_end); with work stealing it is a set of chunk_size
+    // chunks, starting with the chunks of the static share. While tracing, the
+    // tasks and blobs the thread actually ran are counted for traced().
+    template <class Task>
+    void for_share(int t, PhaseItems items, int n, int chunk_size, int share_begin, int share_end, const Task& task);
+    void count_share(int t, PhaseItems items, int begin, int end);
+    StepParams make_step_params() const;
+    ForceLookup make_force_lookup() const;
+    CellKernelArgs make_cell_kernel_args();
+    ListKernelArgs make_list_kernel_args();
+
+    WorldParams world_params;
+    std::vector<float> rule_table;
+    ForceTable force_table;
+
+    BlobStore blob_store;
+    ThreadPool thread_pool;
+    WorkStealingScheduler task_scheduler;
+    SpatialGrid grid;
+    CellPartition partition;
+    BlobReorder reorder;
+    ForceAccumulator accumulator;
+    NeighborList lists;
+
+    KernelIsa isa;
+    CellKernel cell_kernel;
+    ListKernel list_kernel;
+    StepFunctions step_functions;
+    StepParams step_params;
+
+    float mouse_x = 0.0f;
+    float mouse_y = 0.0f;
+    bool mouse_enabled = false;
+
+    // per-step state read by the phases
+    std::vector<Phase> step_phases;
+    std::vector<Phase> grid_phases;  // the grid build of step_phases on its own, for snapshot()
+    std::chrono::steady_clock::time_point stage_start[NUM_STEP_STAGES];  // written by thread 0
+    StepTiming last_timing = {};
+    Profiler* profiler = nullptr;
+    TraceRecorder* tracer = nullptr;
+    bool tracing = false;  // the tracer records the current pool run
+    int profiler_thread = 0;
+    int stage_sections[NUM_STEP_STAGES];
+    long long step_count = 0;
+    uint32_t rule_generation = 0;
+    uint32_t blob_generation = 0;
+    int cell_size = 0;
+    int grid_size = 0;
+    bool use_lists = false;
+    bool use_accumulator = false;
+    bool reorder_now = false;
+    bool lists_stale = true;
+    bool rebuild_lists = false;
+    bool build_grid = true;  // the grid is only needed to (re)build the lists in list mode
+    bool counts_ready = false;  // the last integrate phase already counted the blobs into this grid
+    bool count_grid = true;
+    bool grid_ready = false;  // snapshot() already built the grid of the current positions
+    std::vector<float> thread_displacement_sq;
+    std::vector<uint64_t> thread_checksum;
+    uint64_t state_checksum = 0;
+    std::vector<int> thread_share_tasks;  // for_share() tasks and blobs of the current phase, while tracing
+    std::vector<int> thread_share_blobs;
+};
+
+template <class Task>
+void World::for_share(int t, PhaseItems items, int n, int chunk_size, int share_begin, int share_end, const Task& task) {
+    if (!world_params.work_stealing) {
+        if (tracing) {
+            count_share(t, items, share_begin, share_end);
+        }
+        task(share_begin, share_end);
+        return;
+    }
+    int num_chunks = (n + chunk_size - 1) / chunk_size;
+    int first = share_begin / chunk_size;
+    int last = t == thread_pool.size() - 1 ? num_chunks : share_end / chunk_size;
+    task_scheduler.run(t, first, last, [&](int chunk) {
+        int begin = chunk * chunk_size;
+        int end = std::min(n, (chunk + 1) * chunk_size);
+        if (tracing) {
+            count_share(t, items, begin, end);
+        }
+        task(begin, end);
+    });
+}